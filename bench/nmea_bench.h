@@ -0,0 +1,40 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NMEA_BENCH_H
+#define NMEA_BENCH_H
+
+/* must be included before any system headers */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <time.h>
+
+/* monotonic time in nanoseconds */
+static inline unsigned long long int nmea_bench_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((unsigned long long int)ts.tv_sec * 1000000000ull) + ts.tv_nsec;
+}
+
+static volatile unsigned long long int nmea_bench_sink_val;
+
+/* stops the compiler from optimising away a result */
+static inline void nmea_bench_sink(const unsigned long long int v) {
+  nmea_bench_sink_val = v;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Compares nmea_checksum against the char at a time xor that nmea_parse does,
+ * for spans of typical field and sentence lengths. */
+
+#include "nmea_bench.h"
+
+#include "../nmea.h"
+
+#include <stdio.h>
+
+static const unsigned long long int BENCH_BYTES = 1ull << 28;
+
+/* the per char path in nmea_parse, kept out of line so that it is not
+ * vectorised into the caller */
+static __attribute__((noinline)) unsigned char
+per_char_checksum(const char *const buf, const size_t len) {
+  unsigned char checksum = 0;
+  size_t i = 0;
+  while (i < len) {
+    checksum ^= buf[i];
+    ++i;
+  }
+  return checksum;
+}
+
+int main(void) {
+  static const size_t lengths[] = {4, 8, 16, 32, 64, 82, 4096};
+  static char buf[4096];
+
+  size_t i = 0;
+  while (i < sizeof(buf)) {
+    buf[i] = (char)((i * 37) + 11);
+    ++i;
+  }
+
+  printf("len,per_char_ns_per_byte,kernel_ns_per_byte\n");
+  i = 0;
+  while (i < (sizeof(lengths) / sizeof(lengths[0]))) {
+    const size_t len = lengths[i];
+    const unsigned long long int reps = BENCH_BYTES / len;
+    unsigned long long int acc = 0;
+
+    unsigned long long int start = nmea_bench_ns();
+    unsigned long long int r = 0;
+    while (r < reps) {
+      acc += per_char_checksum(&buf[r & 7], len - (r & 1));
+      ++r;
+    }
+    unsigned long long int per_char = nmea_bench_ns() - start;
+
+    start = nmea_bench_ns();
+    r = 0;
+    while (r < reps) {
+      acc += nmea_checksum(&buf[r & 7], len - (r & 1));
+      ++r;
+    }
+    unsigned long long int kernel = nmea_bench_ns() - start;
+
+    nmea_bench_sink(acc);
+    printf("%u,%.3f,%.3f\n", (unsigned int)len,
+           (double)per_char / (double)(reps * len),
+           (double)kernel / (double)(reps * len));
+    ++i;
+  }
+  return 0;
+}
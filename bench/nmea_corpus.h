@@ -0,0 +1,263 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NMEA_CORPUS_H
+#define NMEA_CORPUS_H
+
+#include "../nmea.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * A deterministic generator of NMEA sentences with realistic field widths,
+ * mixed talkers, checksum errors and garbage between sentences, for
+ * benchmarks. The same seed always gives the same corpus.
+ */
+
+/* one sentence in NMEA_CORPUS_BAD_CHECKSUM has its checksum corrupted, and
+ * one in NMEA_CORPUS_GARBAGE is followed by a run of garbage */
+#define NMEA_CORPUS_BAD_CHECKSUM (64)
+#define NMEA_CORPUS_GARBAGE (128)
+
+struct nmea_corpus {
+  char *buf;
+  size_t len;
+  size_t capacity;
+  /* the sentences written, including those with bad checksums */
+  unsigned long int sentences;
+  unsigned long int state;
+  /* the time of day and date of the sentences, advanced once per epoch */
+  unsigned long int tod;
+  unsigned long int day;
+};
+
+static inline void nmea_corpus_init(struct nmea_corpus *const c,
+                                    char *const buf, const size_t capacity,
+                                    const unsigned long int seed) {
+  c->buf = buf;
+  c->len = 0;
+  c->capacity = capacity;
+  c->sentences = 0;
+  c->state = seed;
+  c->tod = 43200;
+  c->day = 1;
+}
+
+/* a pseudo random number from 0 up to but not including n */
+static inline unsigned long int nmea_corpus_rand(struct nmea_corpus *const c,
+                                                 const unsigned long int n) {
+  c->state = (c->state * 1103515245ul) + 12345ul;
+  return ((c->state >> 16) & 0x7fff) % n;
+}
+
+static inline const char *nmea_corpus_talker(struct nmea_corpus *const c) {
+  /* mostly GPS and combined, as most receivers output */
+  static const char *const talkers[] = {"GP", "GP", "GP", "GN", "GN",
+                                        "GL", "GA", "GB", "BD", "GQ"};
+  return talkers[nmea_corpus_rand(c, sizeof(talkers) / sizeof(talkers[0]))];
+}
+
+/* appends "$" body "*" checksum "\r\n", corrupting some checksums and adding
+ * garbage after some sentences. Returns -1 if it doesn't fit. */
+static inline int nmea_corpus_put(struct nmea_corpus *const c,
+                                  const char *const body) {
+  const size_t len = strlen(body);
+  /* the sentence and the longest run of garbage */
+  if ((c->len + len + 6 + 40) > c->capacity) {
+    return -1;
+  }
+  unsigned char checksum = 0;
+  size_t i = 0;
+  while (i < len) {
+    checksum ^= body[i];
+    ++i;
+  }
+  if (nmea_corpus_rand(c, NMEA_CORPUS_BAD_CHECKSUM) == 0) {
+    checksum ^= (unsigned char)(nmea_corpus_rand(c, 255) + 1);
+  }
+  c->buf[c->len] = '$';
+  memcpy(&c->buf[c->len + 1], body, len);
+  c->len += len + 1;
+  c->len += sprintf(&c->buf[c->len], "*%02X\r\n", checksum);
+  ++c->sentences;
+  if (nmea_corpus_rand(c, NMEA_CORPUS_GARBAGE) == 0) {
+    /* line noise, never a '$' so it doesn't start a sentence */
+    const unsigned long int garbage = nmea_corpus_rand(c, 40) + 1;
+    i = 0;
+    while (i < garbage) {
+      char g = (char)nmea_corpus_rand(c, 256);
+      c->buf[c->len + i] = (g == '$') ? '#' : g;
+      ++i;
+    }
+    c->len += garbage;
+  }
+  return 0;
+}
+
+/* writes "ddmm.mmmmm,N" or "dddmm.mmmmm,E", with degrees digits of width 2 or
+ * 3 */
+static inline int nmea_corpus_angle(struct nmea_corpus *const c,
+                                    char *const buf, const size_t size,
+                                    const unsigned int width,
+                                    const char *const dirs) {
+  return snprintf(buf, size, "%0*lu%02lu.%05lu,%c", (int)width,
+                  nmea_corpus_rand(c, (width == 2) ? 90 : 180),
+                  nmea_corpus_rand(c, 60), nmea_corpus_rand(c, 100000),
+                  dirs[nmea_corpus_rand(c, 2)]);
+}
+
+static inline void nmea_corpus_hms(const struct nmea_corpus *const c,
+                                   char *const buf, const size_t size) {
+  snprintf(buf, size, "%02lu%02lu%02lu.00", (c->tod / 3600) % 24,
+           (c->tod / 60) % 60, c->tod % 60);
+}
+
+/*
+ * Appends a sentence of the given type, or a whole set of 1 to 4 sentences
+ * for GSV. Returns 0 on success or -1 if the buffer is full, in which case
+ * nothing is appended.
+ */
+static inline int nmea_corpus_add(struct nmea_corpus *const c,
+                                  const enum nmea_sentences sentence) {
+  char body[192];
+  char lat[32];
+  char lon[32];
+  char hms[32];
+  nmea_corpus_angle(c, lat, sizeof(lat), 2, "NS");
+  nmea_corpus_angle(c, lon, sizeof(lon), 3, "EW");
+  nmea_corpus_hms(c, hms, sizeof(hms));
+  const char *const talker = nmea_corpus_talker(c);
+  switch (sentence) {
+  case NMEA_SENTENCE_GGA:
+    snprintf(body, sizeof(body), "%sGGA,%s,%s,%s,%lu,%02lu,%lu.%02lu,%lu.%lu,M,"
+                                 "%lu.%lu,M,,",
+             talker, hms, lat, lon, nmea_corpus_rand(c, 3),
+             nmea_corpus_rand(c, 24), nmea_corpus_rand(c, 5),
+             nmea_corpus_rand(c, 100), nmea_corpus_rand(c, 3000),
+             nmea_corpus_rand(c, 10), nmea_corpus_rand(c, 60),
+             nmea_corpus_rand(c, 10));
+    return nmea_corpus_put(c, body);
+  case NMEA_SENTENCE_GLL:
+    snprintf(body, sizeof(body), "%sGLL,%s,%s,%s,A,A", talker, lat, lon, hms);
+    return nmea_corpus_put(c, body);
+  case NMEA_SENTENCE_GSA: {
+    int len = snprintf(body, sizeof(body), "%sGSA,A,%lu", talker,
+                       nmea_corpus_rand(c, 3) + 1);
+    const unsigned long int used = nmea_corpus_rand(c, 13);
+    unsigned long int i = 0;
+    while (i < 12) {
+      if (i < used) {
+        len += snprintf(&body[len], sizeof(body) - len, ",%02lu",
+                        nmea_corpus_rand(c, 32) + 1);
+      } else {
+        body[len++] = ',';
+      }
+      ++i;
+    }
+    snprintf(&body[len], sizeof(body) - len, ",%lu.%02lu,%lu.%02lu,%lu.%02lu",
+             nmea_corpus_rand(c, 10), nmea_corpus_rand(c, 100),
+             nmea_corpus_rand(c, 10), nmea_corpus_rand(c, 100),
+             nmea_corpus_rand(c, 10), nmea_corpus_rand(c, 100));
+    return nmea_corpus_put(c, body);
+  }
+  case NMEA_SENTENCE_GSV: {
+    const size_t start = c->len;
+    const unsigned long int sentences = c->sentences;
+    const unsigned long int sats = nmea_corpus_rand(c, 16) + 1;
+    const unsigned long int total = (sats + 3) / 4;
+    unsigned long int no = 1;
+    while (no <= total) {
+      int len = snprintf(body, sizeof(body), "%sGSV,%lu,%lu,%02lu", talker,
+                         total, no, sats);
+      unsigned long int i = (no - 1) * 4;
+      while ((i < sats) && (i < (no * 4))) {
+        if (nmea_corpus_rand(c, 4) == 0) {
+          /* a satellite that is not being received */
+          len += snprintf(&body[len], sizeof(body) - len, ",%02lu,,,",
+                          nmea_corpus_rand(c, 32) + 1);
+        } else {
+          len += snprintf(
+              &body[len], sizeof(body) - len, ",%02lu,%02lu,%03lu,%02lu",
+              nmea_corpus_rand(c, 32) + 1, nmea_corpus_rand(c, 90),
+              nmea_corpus_rand(c, 360), nmea_corpus_rand(c, 50));
+        }
+        ++i;
+      }
+      if (nmea_corpus_put(c, body) != 0) {
+        c->len = start;
+        c->sentences = sentences;
+        return -1;
+      }
+      ++no;
+    }
+    return 0;
+  }
+  case NMEA_SENTENCE_RMC:
+    snprintf(body, sizeof(body),
+             "%sRMC,%s,A,%s,%s,%lu.%03lu,%lu.%02lu,%02lu%02lu%02lu,,,A", talker,
+             hms, lat, lon, nmea_corpus_rand(c, 100), nmea_corpus_rand(c, 1000),
+             nmea_corpus_rand(c, 360), nmea_corpus_rand(c, 100),
+             (c->day % 28) + 1, ((c->day / 28) % 12) + 1, (c->day / 336) % 100);
+    return nmea_corpus_put(c, body);
+  case NMEA_SENTENCE_VTG:
+  default:
+    snprintf(body, sizeof(body),
+             "%sVTG,%lu.%02lu,T,,M,%lu.%03lu,N,%lu.%03lu,K,A", talker,
+             nmea_corpus_rand(c, 360), nmea_corpus_rand(c, 100),
+             nmea_corpus_rand(c, 100), nmea_corpus_rand(c, 1000),
+             nmea_corpus_rand(c, 200), nmea_corpus_rand(c, 1000));
+    return nmea_corpus_put(c, body);
+  }
+}
+
+/*
+ * Fills the buffer with epochs of the sentences in the mask, in the order a
+ * receiver outputs them, advancing the time by a second each epoch. Returns
+ * the length of the corpus.
+ */
+static inline size_t nmea_corpus_fill(struct nmea_corpus *const c,
+                                      const nmea_sentence_bitmap_t sentences) {
+  static const enum nmea_sentences order[] = {
+      NMEA_SENTENCE_RMC, NMEA_SENTENCE_VTG, NMEA_SENTENCE_GGA,
+      NMEA_SENTENCE_GSA, NMEA_SENTENCE_GSV, NMEA_SENTENCE_GLL};
+  nmea_sentence_bitmap_t all = 0;
+  unsigned int i = 0;
+  while (i < (sizeof(order) / sizeof(order[0]))) {
+    all |= NMEA_SB1 << order[i];
+    ++i;
+  }
+  if ((sentences & all) == 0) {
+    return c->len;
+  }
+  while (1) {
+    i = 0;
+    while (i < (sizeof(order) / sizeof(order[0]))) {
+      if ((sentences & (NMEA_SB1 << order[i])) != 0) {
+        if (nmea_corpus_add(c, order[i]) != 0) {
+          return c->len;
+        }
+      }
+      ++i;
+    }
+    ++c->tod;
+    if (c->tod == 86400) {
+      c->tod = 0;
+      ++c->day;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,126 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Sentences per second written by nmea_encode, against snprintf of the same
+ * fields converted to double, for GGA and RMC over a track of changing
+ * positions. */
+
+#include "nmea_bench.h"
+
+#include "../nmea_encode.h"
+#include "../nmea_float.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const unsigned long int BENCH_SENTENCES = 1ul << 21;
+
+/* moves d along a track, changing every field written */
+static void step(struct nmea_data *const d, const unsigned long int i) {
+  d->latitude += (long long int)1 << 40;
+  d->longitude -= (long long int)3 << 40;
+  d->time += 1;
+  d->altitude = (long int)(i & 0xffff) - 0x8000;
+  d->speed = (i * 977) & 0x3fffff;
+  d->true_track = (i * 131) % (360l << 16);
+  d->hdop = 0x10000 + (i & 0xffff);
+  d->satellites_tracked = i % 13;
+}
+
+static void put_angle(char *const buf, const size_t len, const double deg,
+                      const int degree_digits) {
+  const double a = (deg < 0) ? -deg : deg;
+  const int whole = (int)a;
+  snprintf(buf, len, "%0*d%09.6f", degree_digits, whole, (a - whole) * 60);
+}
+
+/* a sentence written with snprintf the way a simulator would */
+static size_t printf_sentence(const struct nmea_data *const d,
+                              const enum nmea_sentences sentence,
+                              char *const buf, const size_t len) {
+  char body[128];
+  char lat[24];
+  char lon[24];
+  const double latitude = nmea_fxp_to_double(d->latitude, NMEA_FIELD_LATITUDE);
+  const double longitude =
+      nmea_fxp_to_double(d->longitude, NMEA_FIELD_LONGITUDE);
+  put_angle(lat, sizeof(lat), latitude, 2);
+  put_angle(lon, sizeof(lon), longitude, 3);
+  const long long int tod = d->time % 86400;
+  if (sentence == NMEA_SENTENCE_GGA) {
+    snprintf(body, sizeof(body),
+             "GPGGA,%02lld%02lld%02lld.00,%s,%c,%s,%c,%u,%02u,%.3f,%.2f,M,"
+             "%.2f,M,,",
+             tod / 3600, (tod / 60) % 60, tod % 60, lat,
+             (latitude < 0) ? 'S' : 'N', lon, (longitude < 0) ? 'W' : 'E',
+             (unsigned int)d->fix_quality, d->satellites_tracked,
+             nmea_ufxp_to_double(d->hdop, NMEA_FIELD_HDOP),
+             nmea_fxp_to_double(d->altitude, NMEA_FIELD_ALTITUDE),
+             nmea_fxp_to_double(d->geoid_height, NMEA_FIELD_GEOID_HEIGHT));
+  } else {
+    snprintf(body, sizeof(body),
+             "GPRMC,%02lld%02lld%02lld.00,A,%s,%c,%s,%c,%.3f,%.3f,010120,"
+             "%.3f,E,A",
+             tod / 3600, (tod / 60) % 60, tod % 60, lat,
+             (latitude < 0) ? 'S' : 'N', lon, (longitude < 0) ? 'W' : 'E',
+             nmea_ufxp_to_double(d->speed, NMEA_FIELD_SPEED),
+             nmea_fxp_to_double(d->true_track, NMEA_FIELD_TRUE_TRACK),
+             nmea_fxp_to_double(d->magnetic_variation,
+                                NMEA_FIELD_MAGNETIC_VARIATION));
+  }
+  const int n = snprintf(buf, len, "$%s*%02X\r\n", body,
+                         nmea_checksum(body, strlen(body)));
+  return (n > 0) ? (size_t)n : 0;
+}
+
+static void bench(const char *const name, const enum nmea_sentences sentence) {
+  static char buf[256];
+  struct nmea_data d;
+  memset(&d, 0, sizeof(d));
+  d.talker = NMEA_TALKER_GP;
+  d.latitude = 51ll << 56;
+  d.longitude = -(1ll << 55);
+  d.time = 1577836800;
+
+  unsigned long long int bytes = 0;
+  unsigned long long int start = nmea_bench_ns();
+  unsigned long int i = 0;
+  while (i < BENCH_SENTENCES) {
+    step(&d, i);
+    bytes += printf_sentence(&d, sentence, buf, sizeof(buf));
+    ++i;
+  }
+  const unsigned long long int printf_ns = nmea_bench_ns() - start;
+
+  start = nmea_bench_ns();
+  i = 0;
+  while (i < BENCH_SENTENCES) {
+    step(&d, i);
+    bytes += nmea_encode(&d, sentence, buf, sizeof(buf));
+    ++i;
+  }
+  const unsigned long long int encode_ns = nmea_bench_ns() - start;
+  nmea_bench_sink(bytes + buf[7]);
+
+  printf("%s,%.0f,%.0f\n", name, (double)BENCH_SENTENCES * 1e9 / printf_ns,
+         (double)BENCH_SENTENCES * 1e9 / encode_ns);
+}
+
+int main(void) {
+  printf("sentence,printf_sentences_per_s,encode_sentences_per_s\n");
+  bench("GGA", NMEA_SENTENCE_GGA);
+  bench("RMC", NMEA_SENTENCE_RMC);
+  return 0;
+}
@@ -0,0 +1,273 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Cost of each field handler in HANDLER_LUT over a representative value of
+ * its field, driven through the same dispatch as the parser. Reports cycles,
+ * instructions and branch misses per byte from Linux perf counters, and
+ * nanoseconds per byte from the clock. Where the counters can't be opened
+ * (not Linux, no PMU in a VM, or perf_event_paranoid too high) only the time
+ * is reported and the counter columns are left empty.
+ *
+ * Includes nmea.c to reach its static handlers, so is built on its own rather
+ * than linked with it:
+ *
+ *   gcc -O2 -o nmea_handler_bench nmea_handler_bench.c
+ *
+ * Build once per mode, the mode is in the first columns of the output. The
+ * handlers are measured eagerly in every mode, NMEA_LAZY_DECODE only changes
+ * which of them the parser calls. */
+
+/* must be defined before any system headers are included, for syscall */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "nmea_bench.h"
+
+#include "../nmea.c"
+
+#include <stdio.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(NMEA_SWITCH_DISPATCH)
+static const char DISPATCH[] = "switch";
+#else
+static const char DISPATCH[] = "pointer";
+#endif
+
+#if defined(NMEA_FXP_DEFERRED)
+static const char FXP[] = "deferred";
+#else
+static const char FXP[] = "divide";
+#endif
+
+static const unsigned long int BENCH_BYTES = 1ul << 25;
+
+enum bench_counter {
+  BENCH_COUNTER_CYCLES = 0,
+  BENCH_COUNTER_INSTRUCTIONS,
+  BENCH_COUNTER_BRANCH_MISSES,
+  BENCH_COUNTERS
+};
+
+/* a group of counters read together, fds[0] leads the group, or -1 if the
+ * counters are unavailable */
+struct bench_counters {
+  int fds[BENCH_COUNTERS];
+};
+
+#if defined(__linux__)
+static int counter_open(const unsigned long long int config,
+                        const int group) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = (group < 0) ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+static void counters_open(struct bench_counters *const c) {
+  c->fds[0] = -1;
+#if defined(__linux__)
+  static const unsigned long long int configs[BENCH_COUNTERS] = {
+      [BENCH_COUNTER_CYCLES] = PERF_COUNT_HW_CPU_CYCLES,
+      [BENCH_COUNTER_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+      [BENCH_COUNTER_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES};
+  unsigned int i = 0;
+  while (i < BENCH_COUNTERS) {
+    c->fds[i] = counter_open(configs[i], c->fds[0]);
+    if (c->fds[i] < 0) {
+      /* all or nothing, so that every row has the same columns */
+      while (i > 0) {
+        --i;
+        close(c->fds[i]);
+      }
+      c->fds[0] = -1;
+      return;
+    }
+    ++i;
+  }
+#endif
+}
+
+static void counters_close(struct bench_counters *const c) {
+#if defined(__linux__)
+  if (c->fds[0] >= 0) {
+    unsigned int i = 0;
+    while (i < BENCH_COUNTERS) {
+      close(c->fds[i]);
+      ++i;
+    }
+  }
+#endif
+  c->fds[0] = -1;
+}
+
+static void counters_start(const struct bench_counters *const c) {
+#if defined(__linux__)
+  if (c->fds[0] >= 0) {
+    ioctl(c->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(c->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+#else
+  (void)c;
+#endif
+}
+
+/* returns 0 with the counts since counters_start, or -1 if unavailable */
+static int counters_stop(const struct bench_counters *const c,
+                         unsigned long long int counts[BENCH_COUNTERS]) {
+#if defined(__linux__)
+  if (c->fds[0] >= 0) {
+    ioctl(c->fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    /* the number of counters followed by their values */
+    unsigned long long int group[BENCH_COUNTERS + 1];
+    if ((read(c->fds[0], group, sizeof(group)) == (ssize_t)sizeof(group)) &&
+        (group[0] == BENCH_COUNTERS)) {
+      memcpy(counts, &group[1], sizeof(group) - sizeof(group[0]));
+      return 0;
+    }
+  }
+#else
+  (void)c;
+  (void)counts;
+#endif
+  return -1;
+}
+
+/* parses a field from start to end handler the way nmea_parse does once its
+ * sentence and field are known */
+static void parse_field(struct nmea *const n, const enum nmea_fields field,
+                        const char *const value, const size_t len) {
+  n->state.field = field;
+  n->state.field_kind = FIELD_KIND_LUT[field];
+  n->state.field_handlers = &HANDLER_LUT[field];
+  n->state.field_handlers->start_handler(n);
+  size_t i = 0;
+  while (i < len) {
+    field_char(n, value[i]);
+    ++i;
+  }
+  n->state.field_handlers->end_handler(n);
+}
+
+static void bench(struct bench_counters *const c, const char *const name,
+                  const enum nmea_fields field, const char *const value) {
+  const size_t len = strlen(value);
+  const unsigned long int reps = BENCH_BYTES / len;
+  struct nmea n;
+  nmea_init(&n);
+
+  /* warm the caches and branch predictors */
+  unsigned long int r = 0;
+  while (r < (reps / 16)) {
+    n.state.gsv_satellite_index = 0;
+    parse_field(&n, field, value, len);
+    ++r;
+  }
+
+  unsigned long long int counts[BENCH_COUNTERS];
+  counters_start(c);
+  const unsigned long long int start = nmea_bench_ns();
+  r = 0;
+  while (r < reps) {
+    /* the GSV satellite handlers move on to the next satellite after each
+     * SNR, keep them on the first */
+    n.state.gsv_satellite_index = 0;
+    parse_field(&n, field, value, len);
+    ++r;
+  }
+  const unsigned long long int elapsed = nmea_bench_ns() - start;
+  const int counted = counters_stop(c, counts);
+  nmea_bench_sink(n.data.time + n.data.latitude + n.data.longitude +
+                  n.data.sats[0].snr + n.state.fxpse.fxp.val);
+
+  const double bytes = (double)reps * len;
+  printf("%s,%s,%s,%s,%.3f", DISPATCH, FXP, name, value,
+         (double)elapsed / bytes);
+  if (counted == 0) {
+    printf(",%.3f,%.3f,%.4f\n", (double)counts[BENCH_COUNTER_CYCLES] / bytes,
+           (double)counts[BENCH_COUNTER_INSTRUCTIONS] / bytes,
+           (double)counts[BENCH_COUNTER_BRANCH_MISSES] / bytes);
+  } else {
+    printf(",,,\n");
+  }
+}
+
+int main(void) {
+  static const struct {
+    const char *name;
+    enum nmea_fields field;
+    const char *value;
+  } rows[] = {
+      {"header", NMEA_FIELD_HEADER, "GPGGA"},
+      {"time", NMEA_FIELD_TIME, "175456.00"},
+      {"date", NMEA_FIELD_DATE, "080321"},
+      {"latitude", NMEA_FIELD_LATITUDE, "5104.34432"},
+      {"latitude_dir", NMEA_FIELD_LATITUDE_DIR, "N"},
+      {"longitude", NMEA_FIELD_LONGITUDE, "00147.29814"},
+      {"longitude_dir", NMEA_FIELD_LONGITUDE_DIR, "W"},
+      {"fix_quality", NMEA_FIELD_FIX_QUALITY, "1"},
+      {"satellites_tracked", NMEA_FIELD_SATELLITES_TRACKED, "08"},
+      {"hdop", NMEA_FIELD_HDOP, "2.88"},
+      {"altitude", NMEA_FIELD_ALTITUDE, "61.8"},
+      {"geoid_height", NMEA_FIELD_GEOID_HEIGHT, "-47.5"},
+      {"fix_3d", NMEA_FIELD_FIX_3D, "3"},
+      {"prns_tracked", NMEA_FIELD_PRNS_TRACKED, "16"},
+      {"pdop", NMEA_FIELD_PDOP, "3.12"},
+      {"vdop", NMEA_FIELD_VDOP, "1.50"},
+      {"gsv_sentences_total", NMEA_FIELD_GSV_SENTENCES_TOTAL, "3"},
+      {"sentence_no", NMEA_FIELD_SENTENCE_NO, "1"},
+      {"satellites_in_view", NMEA_FIELD_SATELLITES_IN_VIEW, "11"},
+      {"prn", NMEA_FIELD_PRN, "16"},
+      {"elevation", NMEA_FIELD_ELEVATION, "76"},
+      {"azimuth", NMEA_FIELD_AZIMUTH, "272"},
+      {"snr", NMEA_FIELD_SNR, "33"},
+      {"gll_active", NMEA_FIELD_GLL_ACTIVE, "A"},
+      {"rmc_active", NMEA_FIELD_RMC_ACTIVE, "A"},
+      {"speed", NMEA_FIELD_SPEED, "34.075"},
+      {"true_track", NMEA_FIELD_TRUE_TRACK, "213.73"},
+      {"magnetic_track", NMEA_FIELD_MAGNETIC_TRACK, "211.20"},
+      {"magnetic_variation", NMEA_FIELD_MAGNETIC_VARIATION, "1.2"},
+      {"magnetic_variation_dir", NMEA_FIELD_MAGNETIC_VARIATION_DIR, "E"},
+      {"ignore", NMEA_FIELD_IGNORE, "ANTSTATUS=OK"}};
+
+  struct bench_counters c;
+  counters_open(&c);
+  if (c.fds[0] < 0) {
+    fprintf(stderr, "perf counters unavailable, reporting time only\n");
+  }
+  printf("dispatch,fxp,handler,value,ns_per_byte,cycles_per_byte,"
+         "instructions_per_byte,branch_misses_per_byte\n");
+  unsigned int i = 0;
+  while (i < (sizeof(rows) / sizeof(rows[0]))) {
+    bench(&c, rows[i].name, rows[i].field, rows[i].value);
+    ++i;
+  }
+  counters_close(&c);
+  return 0;
+}
@@ -0,0 +1,188 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Time per record to parse a generated NMEA log compared with replaying the
+ * same records from a binary log, either scanning two columns or copying out
+ * whole records, and the bytes per fix of the NMEA and binary logs. */
+
+#include "nmea_bench.h"
+
+#include "../nmea_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const unsigned long int BENCH_BYTES = 1ul << 25;
+
+static void count_record(const struct nmea_data *const data,
+                         const enum nmea_sentences sentence,
+                         const nmea_field_bitmap_t fields, void *const ctx) {
+  unsigned long long int *const sum = ctx;
+  (void)sentence;
+  (void)fields;
+  *sum += (unsigned long long int)data->latitude;
+}
+
+static char *generate(unsigned long int *const len) {
+  static const char *const sentences[] = {
+      "$GPRMC,175456.00,A,5104.34432,N,00147.29814,W,34.075,213.73,"
+      "080321,,,A*47\r\n",
+      "$GPVTG,213.73,T,,M,34.075,N,63.106,K,A*3E\r\n",
+      "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+      "47.5,M,,*74\r\n",
+      "$GPGSA,A,2,18,16,23,,,,,,,,,,3.05,2.88,1.00*09\r\n",
+      "$GPGSV,2,1,08,05,02,020,,07,,,33,16,76,272,33,18,58,069,31*48\r\n",
+      "$GPGSV,2,2,08,20,,,24,23,28,121,20,26,,,31,27,46,274,32*7F\r\n",
+      "$GPGLL,5104.34432,N,00147.29814,W,175456.00,A,A*79\r\n"};
+  char *const buf = malloc(BENCH_BYTES);
+  if (buf == 0) {
+    return 0;
+  }
+  unsigned long int l = 0;
+  unsigned int i = 0;
+  while (1) {
+    const char *s = sentences[i % (sizeof(sentences) / sizeof(sentences[0]))];
+    const size_t sl = strlen(s);
+    if ((l + sl) > BENCH_BYTES) {
+      break;
+    }
+    memcpy(&buf[l], s, sl);
+    l += sl;
+    ++i;
+  }
+  *len = l;
+  return buf;
+}
+
+static void parse(const char *const buf, const unsigned long int len,
+                  const struct nmea_callback *const callbacks) {
+  struct nmea n;
+  nmea_init(&n);
+  nmea_set_callbacks(&n, callbacks, 1);
+  unsigned long int i = 0;
+  while (i < len) {
+    i += nmea_parse_buf(&n, &buf[i], len - i);
+  }
+}
+
+int main(void) {
+  unsigned long int len;
+  char *const buf = generate(&len);
+  if (buf == 0) {
+    printf("Failed to allocate the log\n");
+    return -1;
+  }
+  char path[] = "/tmp/nmea_log_benchXXXXXX";
+  const int fd = mkstemp(path);
+  if (fd < 0) {
+    printf("Failed to create the binary log\n");
+    free(buf);
+    return -1;
+  }
+  close(fd);
+
+  struct nmea_log_writer w;
+  if (nmea_log_writer_open(&w, path, 0) != 0) {
+    printf("Failed to open the binary log\n");
+    free(buf);
+    unlink(path);
+    return -1;
+  }
+  const struct nmea_callback write_callbacks[] = {
+      {&nmea_log_callback, ~(nmea_sentence_bitmap_t)0,
+       ~(nmea_field_bitmap_t)0, &w}};
+  parse(buf, len, write_callbacks);
+  nmea_log_writer_close(&w);
+
+  unsigned long long int sum = 0;
+  const struct nmea_callback count_callbacks[] = {
+      {&count_record, ~(nmea_sentence_bitmap_t)0, ~(nmea_field_bitmap_t)0,
+       &sum}};
+  unsigned long long int start = nmea_bench_ns();
+  parse(buf, len, count_callbacks);
+  const unsigned long long int parse_ns = nmea_bench_ns() - start;
+  nmea_bench_sink(sum);
+  free(buf);
+
+  struct nmea_log_reader r;
+  if (nmea_log_open(&r, path) != 0) {
+    printf("Failed to read the binary log\n");
+    unlink(path);
+    return -1;
+  }
+  /* touch the mapping once so both replays read from memory */
+  struct nmea_log_block b;
+  unsigned long int records = 0;
+  /* the generated log has one RMC, the only sentence with a date, per fix */
+  unsigned long int fixes = 0;
+  while (nmea_log_next(&r, &b) == 1) {
+    size_t i = 0;
+    while (i < b.count) {
+      fixes += ((b.fields[i] & NMEA_FIELD_DATE_MASK) != 0) ? 1 : 0;
+      ++i;
+    }
+    records += b.count;
+  }
+  const unsigned long int log_len = r.m.len;
+  nmea_log_close(&r);
+
+  sum = 0;
+  nmea_log_open(&r, path);
+  start = nmea_bench_ns();
+  while (nmea_log_next(&r, &b) == 1) {
+    size_t i = 0;
+    while (i < b.counts[NMEA_LOG_LATITUDE]) {
+      sum += (unsigned long long int)b.latitude[i];
+      ++i;
+    }
+    i = 0;
+    while (i < b.counts[NMEA_LOG_TIME]) {
+      sum ^= (unsigned long long int)b.time[i];
+      ++i;
+    }
+  }
+  const unsigned long long int scan_ns = nmea_bench_ns() - start;
+  nmea_bench_sink(sum);
+  nmea_log_close(&r);
+
+  sum = 0;
+  nmea_log_open(&r, path);
+  start = nmea_bench_ns();
+  while (nmea_log_next(&r, &b) == 1) {
+    size_t i = 0;
+    while (i < b.count) {
+      struct nmea_data data;
+      nmea_log_record(&b, &data);
+      count_record(&data, NMEA_SENTENCE_GGA, 0, &sum);
+      ++i;
+    }
+  }
+  const unsigned long long int record_ns = nmea_bench_ns() - start;
+  nmea_bench_sink(sum);
+  nmea_log_close(&r);
+  unlink(path);
+
+  printf("replay,records,ns_per_record\n");
+  printf("parse,%lu,%.3f\n", records, (double)parse_ns / (double)records);
+  printf("log_scan,%lu,%.3f\n", records, (double)scan_ns / (double)records);
+  printf("log_record,%lu,%.3f\n", records,
+         (double)record_ns / (double)records);
+  printf("\nformat,bytes,bytes_per_fix\n");
+  printf("nmea,%lu,%.1f\n", len, (double)len / (double)fixes);
+  printf("log,%lu,%.1f\n", log_len, (double)log_len / (double)fixes);
+  return 0;
+}
@@ -0,0 +1,109 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Throughput of nmea_parse_file_parallel over a generated log file for 1 up to
+ * twice the online CPUs worth of threads. Takes an optional path to parse
+ * instead of the generated file. */
+
+#include "nmea_bench.h"
+
+#include "../nmea_parallel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const unsigned long int BENCH_BYTES = 1ul << 26;
+
+static void sum_times(const struct nmea_data *const data,
+                  const nmea_field_bitmap_t fields, void *const ctx) {
+  unsigned long long int *const sum = ctx;
+  (void)fields;
+  *sum += (unsigned long long int)data->time;
+}
+
+static int write_log(char *const path) {
+  static const char *const sentences[] = {
+      "$GPRMC,175456.00,A,5104.34432,N,00147.29814,W,34.075,213.73,"
+      "080321,,,A*47\r\n",
+      "$GPVTG,213.73,T,,M,34.075,N,63.106,K,A*3E\r\n",
+      "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+      "47.5,M,,*74\r\n",
+      "$GPGSA,A,2,18,16,23,,,,,,,,,,3.05,2.88,1.00*09\r\n",
+      "$GPGSV,2,1,08,05,02,020,,07,,,33,16,76,272,33,18,58,069,31*48\r\n",
+      "$GPGSV,2,2,08,20,,,24,23,28,121,20,26,,,31,27,46,274,32*7F\r\n",
+      "$GPGLL,5104.34432,N,00147.29814,W,175456.00,A,A*79\r\n"};
+  const int fd = mkstemp(path);
+  if (fd < 0) {
+    return -1;
+  }
+  FILE *const f = fdopen(fd, "wb");
+  if (f == 0) {
+    close(fd);
+    return -1;
+  }
+  unsigned long int len = 0;
+  unsigned int i = 0;
+  while (len < BENCH_BYTES) {
+    const char *s = sentences[i % (sizeof(sentences) / sizeof(sentences[0]))];
+    fputs(s, f);
+    len += strlen(s);
+    ++i;
+  }
+  return fclose(f);
+}
+
+int main(int argc, char **argv) {
+  char path[] = "/tmp/nmea_parallel_benchXXXXXX";
+  const char *file = path;
+  if (argc > 1) {
+    file = argv[1];
+  } else if (write_log(path) != 0) {
+    printf("Failed to write the log file\n");
+    return -1;
+  }
+  FILE *const f = fopen(file, "rb");
+  if (f == 0) {
+    printf("Failed to open file\n");
+    return -1;
+  }
+  fseek(f, 0, SEEK_END);
+  const long int len = ftell(f);
+  fclose(f);
+
+  const long int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  const unsigned int max_threads = (cpus > 0) ? (cpus * 2) : 2;
+
+  printf("threads,ns_per_byte\n");
+  unsigned int threads = 1;
+  while (threads <= max_threads) {
+    unsigned long long int sum = 0;
+    const unsigned long long int start = nmea_bench_ns();
+    if (nmea_parse_file_parallel(file, threads, &sum_times, &sum) != 0) {
+      printf("Failed to parse file\n");
+      break;
+    }
+    const unsigned long long int elapsed = nmea_bench_ns() - start;
+    nmea_bench_sink(sum);
+    printf("%u,%.3f\n", threads, (double)elapsed / (double)len);
+    threads *= 2;
+  }
+
+  if (file == path) {
+    unlink(path);
+  }
+  return 0;
+}
@@ -0,0 +1,109 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Parse throughput of nmea_parse and nmea_parse_buf over a fixed mix of
+ * sentences. Build with and without -DNMEA_SWITCH_DISPATCH and
+ * -DNMEA_FXP_DEFERRED to compare the parser modes. */
+
+#include "nmea_bench.h"
+
+#include "../nmea.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(NMEA_SWITCH_DISPATCH)
+static const char DISPATCH[] = "switch";
+#else
+static const char DISPATCH[] = "pointer";
+#endif
+
+#if defined(NMEA_FXP_DEFERRED)
+static const char FXP[] = "deferred";
+#else
+static const char FXP[] = "divide";
+#endif
+
+static const unsigned int BENCH_REPS = 8;
+
+static char corpus[1 << 22];
+
+int main(void) {
+  static const char *const sentences[] = {
+      "$GPRMC,175456.00,A,5104.34432,N,00147.29814,W,34.075,213.73,"
+      "080321,,,A*47\r\n",
+      "$GPVTG,213.73,T,,M,34.075,N,63.106,K,A*3E\r\n",
+      "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+      "47.5,M,,*74\r\n",
+      "$GPGSA,A,2,18,16,23,,,,,,,,,,3.05,2.88,1.00*09\r\n",
+      "$GPGSV,2,1,08,05,02,020,,07,,,33,16,76,272,33,18,58,069,31*48\r\n",
+      "$GPGSV,2,2,08,20,,,24,23,28,121,20,26,,,31,27,46,274,32*7F\r\n",
+      "$GPGLL,5104.34432,N,00147.29814,W,175456.00,A,A*79\r\n",
+      "$GPTXT,01,01,02,ANTSTATUS=OK*3B\r\n"};
+
+  size_t len = 0;
+  unsigned int i = 0;
+  while (1) {
+    const char *s = sentences[i % (sizeof(sentences) / sizeof(sentences[0]))];
+    size_t slen = strlen(s);
+    if ((len + slen) > sizeof(corpus)) {
+      break;
+    }
+    memcpy(&corpus[len], s, slen);
+    len += slen;
+    ++i;
+  }
+
+  struct nmea n;
+  unsigned long long int ready = 0;
+
+  nmea_init(&n);
+  unsigned long long int start = nmea_bench_ns();
+  unsigned int rep = 0;
+  while (rep < BENCH_REPS) {
+    size_t j = 0;
+    while (j < len) {
+      nmea_parse(&n, corpus[j]);
+      ready += nmea_fields_ready(&n, NMEA_FIELD_LATITUDE_MASK);
+      ++j;
+    }
+    ++rep;
+  }
+  unsigned long long int by_char = nmea_bench_ns() - start;
+
+  nmea_init(&n);
+  start = nmea_bench_ns();
+  rep = 0;
+  while (rep < BENCH_REPS) {
+    const char *p = corpus;
+    size_t remaining = len;
+    while (remaining != 0) {
+      size_t used = nmea_parse_buf(&n, p, remaining);
+      p += used;
+      remaining -= used;
+      ready += nmea_fields_ready(&n, NMEA_FIELD_LATITUDE_MASK);
+    }
+    ++rep;
+  }
+  unsigned long long int by_buf = nmea_bench_ns() - start;
+
+  nmea_bench_sink(ready);
+  printf("dispatch,fxp,api,ns_per_byte\n");
+  printf("%s,%s,nmea_parse,%.3f\n", DISPATCH, FXP,
+         (double)by_char / ((double)len * BENCH_REPS));
+  printf("%s,%s,nmea_parse_buf,%.3f\n", DISPATCH, FXP,
+         (double)by_buf / ((double)len * BENCH_REPS));
+  return 0;
+}
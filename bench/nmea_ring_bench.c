@@ -0,0 +1,88 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Throughput of moving bytes through an nmea_ring from a producer thread to a
+ * consumer thread, for a range of push and pop sizes. */
+
+#include "nmea_bench.h"
+
+#include "../nmea_ring.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+static const size_t BENCH_RING_SIZE = 1 << 16;
+static const unsigned long int BENCH_BYTES = 1ul << 26;
+
+struct bench_thread {
+  struct nmea_ring *ring;
+  size_t chunk;
+};
+
+static void *producer(void *const arg) {
+  const struct bench_thread *const t = arg;
+  static char buf[4096];
+  unsigned long int sent = 0;
+  while (sent < BENCH_BYTES) {
+    const size_t n = nmea_ring_push(t->ring, buf, t->chunk);
+    if (n == 0) {
+      sched_yield();
+    }
+    sent += n;
+  }
+  return 0;
+}
+
+int main(void) {
+  static const size_t chunks[] = {16, 64, 256, 1024, 4096};
+  static char buf[4096];
+
+  printf("ring_bytes,chunk_bytes,ns_per_byte\n");
+  unsigned int i = 0;
+  while (i < (sizeof(chunks) / sizeof(chunks[0]))) {
+    struct nmea_ring r;
+    if (nmea_ring_init(&r, BENCH_RING_SIZE) != 0) {
+      printf("Failed to allocate the ring\n");
+      return -1;
+    }
+    struct bench_thread t = {&r, chunks[i]};
+    const unsigned long long int start = nmea_bench_ns();
+    pthread_t thread;
+    if (pthread_create(&thread, 0, &producer, &t) != 0) {
+      printf("Failed to start the producer\n");
+      nmea_ring_free(&r);
+      return -1;
+    }
+    unsigned long long int sum = 0;
+    unsigned long int received = 0;
+    while (received < BENCH_BYTES) {
+      const size_t n = nmea_ring_pop(&r, buf, chunks[i]);
+      if (n == 0) {
+        sched_yield();
+      }
+      sum += buf[0];
+      received += n;
+    }
+    pthread_join(thread, 0);
+    const unsigned long long int elapsed = nmea_bench_ns() - start;
+    nmea_bench_sink(sum);
+    nmea_ring_free(&r);
+    printf("%lu,%lu,%.3f\n", (unsigned long int)BENCH_RING_SIZE,
+           (unsigned long int)chunks[i], (double)elapsed / (double)BENCH_BYTES);
+    ++i;
+  }
+  return 0;
+}
@@ -0,0 +1,156 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Throughput and latency of nmea_parse_buf for each sentence type, and for a
+ * mix of them all, over a generated corpus with mixed talkers, bad checksums
+ * and garbage. Every field received is decoded, so the parser modes are
+ * compared on the same work. Build once per mode, the mode is in the first
+ * columns of the output. Latencies are per call to nmea_parse_buf, which
+ * returns after each sentence, and include the cost of reading the clock. */
+
+#include "nmea_bench.h"
+#include "nmea_corpus.h"
+
+#include "../nmea.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(NMEA_SWITCH_DISPATCH)
+static const char DISPATCH[] = "switch";
+#else
+static const char DISPATCH[] = "pointer";
+#endif
+
+#if defined(NMEA_FXP_DEFERRED)
+static const char FXP[] = "deferred";
+#else
+static const char FXP[] = "divide";
+#endif
+
+#if defined(NMEA_LAZY_DECODE)
+static const char DECODE[] = "lazy";
+#else
+static const char DECODE[] = "eager";
+#endif
+
+/* the instrumented builds, which add their own cost to every sentence */
+#if defined(NMEA_STATS)
+static const char STATS[] = "on";
+#else
+static const char STATS[] = "off";
+#endif
+
+#if defined(NMEA_LATENCY)
+static const char LATENCY[] = "on";
+#else
+static const char LATENCY[] = "off";
+#endif
+
+static const unsigned int BENCH_REPS = 8;
+static const unsigned long int BENCH_SEED = 1;
+
+#define BENCH_SAMPLES (1ul << 17)
+
+static char corpus[1 << 22];
+static unsigned long long int samples[BENCH_SAMPLES];
+
+static int compare_samples(const void *const a, const void *const b) {
+  const unsigned long long int x = *(const unsigned long long int *)a;
+  const unsigned long long int y = *(const unsigned long long int *)b;
+  return (x > y) - (x < y);
+}
+
+/* parses the corpus once, returning the fields set so it isn't optimised
+ * away */
+static unsigned long long int parse(struct nmea *const n, const size_t len) {
+  unsigned long long int ready = 0;
+  size_t i = 0;
+  while (i < len) {
+    i += nmea_parse_buf(n, &corpus[i], len - i);
+    const nmea_field_bitmap_t fields = n->state.received;
+    if (fields != 0) {
+      nmea_decode(n, fields);
+      n->state.received = 0;
+      ready += fields;
+    }
+  }
+  return ready;
+}
+
+static void bench(const char *const name,
+                  const nmea_sentence_bitmap_t sentences) {
+  struct nmea_corpus c;
+  nmea_corpus_init(&c, corpus, sizeof(corpus), BENCH_SEED);
+  const size_t len = nmea_corpus_fill(&c, sentences);
+
+  struct nmea n;
+  nmea_init(&n);
+  unsigned long long int ready = 0;
+  const unsigned long long int start = nmea_bench_ns();
+  unsigned int rep = 0;
+  while (rep < BENCH_REPS) {
+    ready += parse(&n, len);
+    ++rep;
+  }
+  const unsigned long long int elapsed = nmea_bench_ns() - start;
+
+  nmea_init(&n);
+  size_t count = 0;
+  size_t i = 0;
+  while ((i < len) && (count < BENCH_SAMPLES)) {
+    const unsigned long long int t = nmea_bench_ns();
+    i += nmea_parse_buf(&n, &corpus[i], len - i);
+    const nmea_field_bitmap_t fields = n.state.received;
+    if (fields != 0) {
+      nmea_decode(&n, fields);
+      n.state.received = 0;
+    }
+    samples[count] = nmea_bench_ns() - t;
+    ready += fields;
+    ++count;
+  }
+  qsort(samples, count, sizeof(samples[0]), &compare_samples);
+  nmea_bench_sink(ready);
+
+  const double bytes = (double)len * BENCH_REPS;
+  const double seconds = (double)elapsed / 1e9;
+  printf("%s,%s,%s,%s,%s,%s,%lu,%lu,%.0f,%.0f,%.3f,%llu,%llu\n", DISPATCH,
+         FXP, DECODE, STATS, LATENCY, name, (unsigned long int)len,
+         c.sentences, bytes / seconds,
+         ((double)c.sentences * BENCH_REPS) / seconds,
+         (double)elapsed / bytes, samples[count / 2],
+         samples[(count * 99) / 100]);
+}
+
+int main(void) {
+  static const struct {
+    const char *name;
+    nmea_sentence_bitmap_t sentences;
+  } rows[] = {{"GGA", NMEA_SENTENCE_GGA_MASK}, {"GLL", NMEA_SENTENCE_GLL_MASK},
+              {"GSA", NMEA_SENTENCE_GSA_MASK}, {"GSV", NMEA_SENTENCE_GSV_MASK},
+              {"RMC", NMEA_SENTENCE_RMC_MASK}, {"VTG", NMEA_SENTENCE_VTG_MASK},
+              {"mixed", ~(nmea_sentence_bitmap_t)0}};
+
+  printf("dispatch,fxp,decode,stats,latency,sentence,corpus_bytes,"
+         "corpus_sentences,bytes_per_s,sentences_per_s,ns_per_byte,p50_ns,"
+         "p99_ns\n");
+  unsigned int i = 0;
+  while (i < (sizeof(rows) / sizeof(rows[0]))) {
+    bench(rows[i].name, rows[i].sentences);
+    ++i;
+  }
+  return 0;
+}
@@ -14,12 +14,110 @@
  */
 
 #include "../nmea_float.h"
+#include "../nmea_ring.h"
 
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <termios.h>
 #include <unistd.h>
 
+static void print_data(const struct nmea_data *const data) {
+  printf("tim:\t%llu\n", data->time);
+  printf("lat:\t%f\n", nmea_fxp_to_double(data->latitude, NMEA_FIELD_LATITUDE));
+  printf("lon:\t%f\n",
+         nmea_fxp_to_double(data->longitude, NMEA_FIELD_LONGITUDE));
+  printf("hdp:\t%f\n", nmea_fxp_to_double(data->hdop, NMEA_FIELD_HDOP));
+  printf("pdp:\t%f\n", nmea_fxp_to_double(data->pdop, NMEA_FIELD_PDOP));
+  printf("vdp:\t%f\n", nmea_fxp_to_double(data->vdop, NMEA_FIELD_VDOP));
+  printf("spd:\t%f\n", nmea_fxp_to_double(data->speed, NMEA_FIELD_SPEED));
+  printf("tt:\t%f\n",
+         nmea_fxp_to_double(data->true_track, NMEA_FIELD_TRUE_TRACK));
+  printf("mt:\t%f\n",
+         nmea_fxp_to_double(data->magnetic_track, NMEA_FIELD_MAGNETIC_TRACK));
+  printf("mv:\t%f\n", nmea_fxp_to_double(data->magnetic_variation,
+                                         NMEA_FIELD_MAGNETIC_VARIATION));
+  printf("alt:\t%f\n", nmea_fxp_to_double(data->altitude, NMEA_FIELD_ALTITUDE));
+  printf("gh:\t%f\n",
+         nmea_fxp_to_double(data->geoid_height, NMEA_FIELD_GEOID_HEIGHT));
+  printf("st:\t%u\n", data->satellites_tracked);
+  printf("siv:\t%u\n", data->satellites_in_view);
+  printf("fq:\t%u\n", data->fix_quality);
+  printf("3d:\t%u\n", data->fix_3d);
+  printf("ga:\t%u\n", data->gll_active);
+  printf("ra:\t%u\n", data->rmc_active);
+  unsigned int i = 0;
+  while ((i < data->satellites_in_view) && (i < NMEA_MAX_SATS)) {
+    const struct nmea_sat *sat = &data->sats[i];
+    printf("sat:\t%u\taz:\t%d\tel:\t%d\tsnr:\t%d", sat->prn, sat->azimuth,
+           sat->elevation, sat->snr);
+    unsigned int j = 0;
+    while ((j < data->satellites_tracked) && (j < NMEA_MAX_PRNS_TRACKED)) {
+      if (sat->prn == data->prns_tracked[j]) {
+        printf("\ttkd");
+        break;
+      }
+      ++j;
+    }
+    printf("\n");
+    ++i;
+  }
+  printf("\n");
+}
+
+struct reader {
+  int fd;
+  struct nmea_ring ring;
+  /* the ring is lock free, the lock is only taken to wait for the other
+   * thread when the ring is empty or full */
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  /* set by the reader once the port has no more input */
+  unsigned char done;
+};
+
+/* wakes the other thread if it is waiting on the ring */
+static void reader_signal(struct reader *const r) {
+  pthread_mutex_lock(&r->lock);
+  pthread_cond_signal(&r->cond);
+  pthread_mutex_unlock(&r->lock);
+}
+
+/* reads the serial port on its own thread so that slow parsing or printing
+ * doesn't overrun the UART */
+static void *read_serial(void *const arg) {
+  struct reader *const r = arg;
+  char buf[64];
+  while (1) {
+    ssize_t len = read(r->fd, buf, sizeof(buf));
+    if (len <= 0) {
+      if (len == -1) {
+        printf("Failed to read from serial port\n");
+      }
+      /* the end of the input, the port has hung up */
+      pthread_mutex_lock(&r->lock);
+      r->done = 1;
+      pthread_cond_signal(&r->cond);
+      pthread_mutex_unlock(&r->lock);
+      return 0;
+    }
+    size_t pushed = nmea_ring_push(&r->ring, buf, len);
+    if (pushed < (size_t)len) {
+      /* the ring is full, data is lost if the UART overruns */
+      pthread_mutex_lock(&r->lock);
+      while (pushed < (size_t)len) {
+        const size_t n = nmea_ring_push(&r->ring, &buf[pushed], len - pushed);
+        if (n == 0) {
+          pthread_cond_wait(&r->cond, &r->lock);
+        }
+        pushed += n;
+      }
+      pthread_mutex_unlock(&r->lock);
+    }
+    reader_signal(r);
+  }
+}
+
 int main(int argc, char *argv[]) {
   if (argc != 3) {
     printf("Takes 2 args: The serial port pathname, and the baud rate\n");
@@ -59,68 +157,56 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 
+  struct reader r;
+  r.fd = fd;
+  r.done = 0;
+  pthread_mutex_init(&r.lock, 0);
+  pthread_cond_init(&r.cond, 0);
+  if (nmea_ring_init(&r.ring, 1 << 14) != 0) {
+    printf("Failed to allocate the ring buffer\n");
+    return -1;
+  }
+  pthread_t thread;
+  if (pthread_create(&thread, 0, &read_serial, &r) != 0) {
+    printf("Failed to start the reader thread\n");
+    return -1;
+  }
+
   struct nmea n;
   nmea_init(&n);
 
   const nmea_field_bitmap_t fields =
       NMEA_FIELD_LONGITUDE_MASK | NMEA_FIELD_LATITUDE_MASK;
 
-  char c;
   while (1) {
-    int r = read(fd, &c, 1);
-    if (r == -1) {
-      printf("Failed to read from serial port\n");
-      return -1;
-    } else if (r == 1) {
-      nmea_parse(&n, c);
+    const char *p;
+    size_t len = nmea_ring_peek(&r.ring, &p);
+    if (len == 0) {
+      /* check the ring again under the lock so a push isn't missed */
+      pthread_mutex_lock(&r.lock);
+      while (((len = nmea_ring_peek(&r.ring, &p)) == 0) && (r.done == 0)) {
+        pthread_cond_wait(&r.cond, &r.lock);
+      }
+      pthread_mutex_unlock(&r.lock);
+      if (len == 0) {
+        break;
+      }
+    }
+    size_t used = 0;
+    while (used < len) {
+      used += nmea_parse_buf(&n, &p[used], len - used);
+      /* with NMEA_LAZY_DECODE each sentence's fields must be decoded before
+       * the next starts, print_data reads all of them */
+      nmea_decode(&n, n.state.received);
       if (nmea_fields_ready(&n, fields) == 1) {
-        printf("tim:\t%llu\n", n.data.time);
-        printf("lat:\t%f\n",
-               nmea_fxp_to_double(n.data.latitude, NMEA_FIELD_LATITUDE));
-        printf("lon:\t%f\n",
-               nmea_fxp_to_double(n.data.longitude, NMEA_FIELD_LONGITUDE));
-        printf("hdp:\t%f\n", nmea_fxp_to_double(n.data.hdop, NMEA_FIELD_HDOP));
-        printf("pdp:\t%f\n", nmea_fxp_to_double(n.data.pdop, NMEA_FIELD_PDOP));
-        printf("vdp:\t%f\n", nmea_fxp_to_double(n.data.vdop, NMEA_FIELD_VDOP));
-        printf("spd:\t%f\n",
-               nmea_fxp_to_double(n.data.speed, NMEA_FIELD_SPEED));
-        printf("tt:\t%f\n",
-               nmea_fxp_to_double(n.data.true_track, NMEA_FIELD_TRUE_TRACK));
-        printf("mt:\t%f\n", nmea_fxp_to_double(n.data.magnetic_track,
-                                               NMEA_FIELD_MAGNETIC_TRACK));
-        printf("mv:\t%f\n", nmea_fxp_to_double(n.data.magnetic_variation,
-                                               NMEA_FIELD_MAGNETIC_VARIATION));
-        printf("alt:\t%f\n",
-               nmea_fxp_to_double(n.data.altitude, NMEA_FIELD_ALTITUDE));
-        printf("gh:\t%f\n", nmea_fxp_to_double(n.data.geoid_height,
-                                               NMEA_FIELD_GEOID_HEIGHT));
-        printf("st:\t%u\n", n.data.satellites_tracked);
-        printf("siv:\t%u\n", n.data.satellites_in_view);
-        printf("fq:\t%u\n", n.data.fix_quality);
-        printf("3d:\t%u\n", n.data.fix_3d);
-        printf("ga:\t%u\n", n.data.gll_active);
-        printf("ra:\t%u\n", n.data.rmc_active);
-        unsigned int i = 0;
-        while ((i < n.data.satellites_in_view) && (i < NMEA_MAX_SATS)) {
-          struct nmea_sat *sat = &n.data.sats[i];
-          printf("sat:\t%u\taz:\t%d\tel:\t%d\tsnr:\t%d", sat->prn, sat->azimuth,
-                 sat->elevation, sat->snr);
-          unsigned int j = 0;
-          while ((j < n.data.satellites_tracked) &&
-                 (j < NMEA_MAX_PRNS_TRACKED)) {
-            if (sat->prn == n.data.prns_tracked[j]) {
-              printf("\ttkd");
-              break;
-            }
-            ++j;
-          }
-          printf("\n");
-          ++i;
-        }
-        printf("\n");
+        print_data(&n.data);
       }
     }
+    nmea_ring_release(&r.ring, len);
+    reader_signal(&r);
   }
+  pthread_join(thread, 0);
+  nmea_ring_free(&r.ring);
   close(fd);
   return 0;
 }
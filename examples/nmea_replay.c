@@ -0,0 +1,484 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Replays a capture, or encoder output, as a number of virtual receivers on
+ * pseudo-terminals or FIFOs, to load test ingest without hardware. Sentences
+ * are paced by the time they decode to, at real rate or a multiple of it, and
+ * the rates achieved are printed every second.
+ *
+ * The path of each receiver is printed first, open it as a serial port, for
+ * example with nmea_print_serial. A receiver whose reader falls behind drops
+ * whole sentences that don't fit, like a UART overrun, and the bytes dropped
+ * are counted. */
+
+/* must be defined before any system headers are included, for posix_openpt */
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
+#endif
+
+#include "../nmea_mmap.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+static const unsigned long long int NS_PER_S = 1000000000ull;
+static const long long int SECONDS_IN_DAY = 86400;
+
+/* the bytes up to and including a sentence and its line ending, and when to
+ * write them in ns from the start of the capture */
+struct chunk {
+  size_t end;
+  unsigned long long int at;
+  /* the sentences started in the chunk, including those not supported */
+  unsigned int sentences;
+};
+
+struct schedule {
+  struct chunk *chunks;
+  size_t count;
+  size_t capacity;
+  const char *buf;
+  size_t len;
+  size_t end;
+  /* ns per second of decoded time, 0 to write as fast as possible */
+  double ns_per_s;
+  long long int last_time;
+  double last_fraction;
+  unsigned long long int at;
+  int timed;
+  int rc;
+};
+
+struct receiver {
+  int fd;
+  /* the pty's slave end, held open so that writes don't fail before a reader
+   * opens it, or -1 */
+  int slave;
+  char path[64];
+  /* the rest of a sentence that was only partly written */
+  const char *pending;
+  size_t pending_len;
+  unsigned long long int dropped;
+};
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(const int sig) {
+  (void)sig;
+  stop = 1;
+}
+
+static unsigned long long int now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((unsigned long long int)ts.tv_sec * NS_PER_S) + ts.tv_nsec;
+}
+
+static void sleep_until(const unsigned long long int ns) {
+  struct timespec ts;
+  ts.tv_sec = ns / NS_PER_S;
+  ts.tv_nsec = ns % NS_PER_S;
+  /* interrupted by a signal to stop */
+  (void)clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0);
+}
+
+/* seconds between two decoded times, compared by time of day so that a date
+ * arriving part way through or midnight is not a gap, and a time that goes
+ * back is no gap at all */
+static long long int time_step(const long long int from,
+                               const long long int to) {
+  long long int step =
+      ((to % SECONDS_IN_DAY) - (from % SECONDS_IN_DAY)) % SECONDS_IN_DAY;
+  if (step < 0) {
+    step += SECONDS_IN_DAY;
+  }
+  return (step > (SECONDS_IN_DAY / 2)) ? 0 : step;
+}
+
+/* the fraction of a second of the time field of a sentence, which the parser
+ * drops, found as the field that is the time of day in hhmmss followed by a
+ * decimal point, so that a receiver that outputs more than once a second is
+ * paced at its own rate */
+static double time_fraction(const char *const sentence, const size_t len,
+                            const long long int time) {
+  const long long int tod = time % SECONDS_IN_DAY;
+  char field[10];
+  snprintf(field, sizeof(field), ",%02u%02u%02u.", (unsigned int)(tod / 3600),
+           (unsigned int)((tod / 60) % 60), (unsigned int)(tod % 60));
+  size_t i = 0;
+  while ((i + 8) <= len) {
+    if (memcmp(&sentence[i], field, 8) == 0) {
+      double fraction = 0;
+      double scale = 0.1;
+      i += 8;
+      while ((i < len) && (sentence[i] >= '0') && (sentence[i] <= '9')) {
+        fraction += (sentence[i] - '0') * scale;
+        scale /= 10;
+        ++i;
+      }
+      return fraction;
+    }
+    ++i;
+  }
+  return 0;
+}
+
+static unsigned int count_sentences(const char *const buf, const size_t len) {
+  unsigned int count = 0;
+  size_t i = 0;
+  while (i < len) {
+    const char *const start = memchr(&buf[i], '$', len - i);
+    if (start == 0) {
+      break;
+    }
+    ++count;
+    i = (start - buf) + 1;
+  }
+  return count;
+}
+
+static void schedule_sentence(struct nmea *const n, const char *const sentence,
+                              const size_t len,
+                              const nmea_field_bitmap_t fields,
+                              void *const ctx) {
+  struct schedule *const s = ctx;
+  if (s->rc != 0) {
+    return;
+  }
+  if ((fields & NMEA_FIELD_TIME_MASK) != 0) {
+    const double fraction = time_fraction(sentence, len, n->data.time);
+    if (s->timed != 0) {
+      const double step = (double)time_step(s->last_time, n->data.time) +
+                          (fraction - s->last_fraction);
+      if (step > 0) {
+        s->at += (unsigned long long int)(step * s->ns_per_s);
+      }
+    }
+    s->last_time = n->data.time;
+    s->last_fraction = fraction;
+    s->timed = 1;
+  }
+  if (s->count == s->capacity) {
+    const size_t capacity = (s->capacity == 0) ? 4096 : (s->capacity * 2);
+    struct chunk *const chunks =
+        realloc(s->chunks, capacity * sizeof(chunks[0]));
+    if (chunks == 0) {
+      s->rc = -1;
+      return;
+    }
+    s->chunks = chunks;
+    s->capacity = capacity;
+  }
+  /* anything between sentences, such as sentences that aren't supported, is
+   * written with the sentence that follows it, and the line ending with the
+   * sentence before it, so that a sentence is dropped whole */
+  size_t end = (sentence - s->buf) + len;
+  while ((end < s->len) && ((s->buf[end] == '\r') || (s->buf[end] == '\n'))) {
+    ++end;
+  }
+  s->chunks[s->count].end = end;
+  s->chunks[s->count].at = s->at;
+  s->chunks[s->count].sentences =
+      count_sentences(&s->buf[s->end], end - s->end);
+  s->end = end;
+  ++s->count;
+}
+
+static int open_pty(struct receiver *const r) {
+  r->fd = posix_openpt(O_RDWR | O_NOCTTY);
+  r->slave = -1;
+  if (r->fd < 0) {
+    return -1;
+  }
+  const char *const path =
+      ((grantpt(r->fd) == 0) && (unlockpt(r->fd) == 0)) ? ptsname(r->fd) : 0;
+  if (path == 0) {
+    return -1;
+  }
+  snprintf(r->path, sizeof(r->path), "%s", path);
+  r->slave = open(r->path, O_RDWR | O_NOCTTY);
+  struct termios options;
+  if ((r->slave < 0) || (tcgetattr(r->slave, &options) != 0)) {
+    return -1;
+  }
+  /* raw, without echo or any translation of the line endings */
+  options.c_iflag &=
+      ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+  options.c_oflag &= ~OPOST;
+  options.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+  options.c_cflag &= ~(CSIZE | PARENB);
+  options.c_cflag |= CS8;
+  if (tcsetattr(r->slave, TCSANOW, &options) != 0) {
+    return -1;
+  }
+  return fcntl(r->fd, F_SETFL, O_NONBLOCK);
+}
+
+static int open_fifo(struct receiver *const r, const char *const prefix,
+                     const unsigned int i) {
+  r->slave = -1;
+  snprintf(r->path, sizeof(r->path), "%s%u", prefix, i);
+  if ((mkfifo(r->path, 0666) != 0) && (errno != EEXIST)) {
+    r->fd = -1;
+    return -1;
+  }
+  /* opened for reading as well so that the open doesn't wait for a reader and
+   * writes don't fail without one, which Linux allows for FIFOs */
+  r->fd = open(r->path, O_RDWR | O_NONBLOCK);
+  return (r->fd < 0) ? -1 : 0;
+}
+
+/* writes what fits of the rest of a partly written sentence, returns 0 once
+ * none of it is left */
+static int write_pending(struct receiver *const r) {
+  if (r->pending_len != 0) {
+    const ssize_t written = write(r->fd, r->pending, r->pending_len);
+    if (written > 0) {
+      r->pending += written;
+      r->pending_len -= written;
+    }
+  }
+  return (r->pending_len == 0) ? 0 : -1;
+}
+
+/* closing a pty discards anything its reader hasn't read yet, so waits until
+ * the deadline for it to be read, FIONREAD is Linux's, along with the rest of
+ * any partly written sentence */
+static void drain_receiver(struct receiver *const r,
+                           const unsigned long long int deadline) {
+  int unread = 0;
+  while ((stop == 0) && (now_ns() < deadline) &&
+         ((write_pending(r) != 0) ||
+          ((r->slave >= 0) && (ioctl(r->slave, FIONREAD, &unread) == 0) &&
+           (unread > 0)))) {
+    struct timespec ts = {0, 1000000};
+    nanosleep(&ts, 0);
+  }
+  r->dropped += r->pending_len;
+}
+
+static void close_receiver(struct receiver *const r) {
+  if (r->slave >= 0) {
+    close(r->slave);
+  }
+  if (r->fd >= 0) {
+    close(r->fd);
+  }
+}
+
+/* writes what fits without blocking, a sentence that is only partly written
+ * is finished before anything else is written, and those due while it is are
+ * dropped whole */
+static void write_receiver(struct receiver *const r, const char *const buf,
+                           const size_t len) {
+  if (write_pending(r) != 0) {
+    r->dropped += len;
+    return;
+  }
+  const ssize_t written = write(r->fd, buf, len);
+  if (written < 0) {
+    r->dropped += len;
+    return;
+  }
+  r->pending = &buf[written];
+  r->pending_len = len - written;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned int receiver_count = 1;
+  double speed = 1;
+  unsigned long int loops = 1;
+  const char *fifo_prefix = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:l:f:")) != -1) {
+    switch (opt) {
+    case 'n':
+      receiver_count = strtoul(optarg, 0, 0);
+      break;
+    case 's':
+      speed = strtod(optarg, 0);
+      break;
+    case 'l':
+      loops = strtoul(optarg, 0, 0);
+      break;
+    case 'f':
+      fifo_prefix = optarg;
+      break;
+    default:
+      break;
+    }
+  }
+  if ((optind != (argc - 1)) || (receiver_count == 0) || (speed < 0)) {
+    printf("Usage: %s [-n receivers] [-s speed] [-l loops] [-f fifo prefix] "
+           "file\n"
+           "  -n  the number of receivers, each replaying the whole file, "
+           "default 1\n"
+           "  -s  the multiple of real time to replay at, 0 for as fast as "
+           "possible,\n"
+           "      default 1\n"
+           "  -l  the number of times to replay the file, 0 for until "
+           "interrupted,\n"
+           "      default 1\n"
+           "  -f  write to FIFOs named with this prefix and the receiver's "
+           "number rather\n"
+           "      than to pseudo-terminals\n",
+           argv[0]);
+    return -1;
+  }
+
+  struct nmea_mmap m;
+  if (nmea_mmap_open(&m, argv[optind]) != 0) {
+    printf("Failed to open file\n");
+    return -1;
+  }
+  struct schedule s;
+  memset(&s, 0, sizeof(s));
+  s.buf = m.buf;
+  s.len = m.len;
+  s.ns_per_s = (speed > 0) ? ((double)NS_PER_S / speed) : 0;
+  struct nmea n;
+  nmea_init(&n);
+  nmea_mmap_parse(&m, &n, 0, &schedule_sentence, &s);
+  if (s.rc != 0) {
+    printf("Failed to allocate the schedule\n");
+    return -1;
+  }
+  /* a second between loops, as between the last time and the first */
+  const unsigned long long int loop_ns =
+      s.at + (unsigned long long int)s.ns_per_s;
+
+  struct receiver *const receivers =
+      calloc(receiver_count, sizeof(receivers[0]));
+  if (receivers == 0) {
+    printf("Failed to allocate the receivers\n");
+    return -1;
+  }
+  int rc = 0;
+  unsigned int i = 0;
+  while (i < receiver_count) {
+    rc = (fifo_prefix != 0) ? open_fifo(&receivers[i], fifo_prefix, i)
+                            : open_pty(&receivers[i]);
+    if (rc != 0) {
+      printf("Failed to open receiver %u: %s\n", i, strerror(errno));
+      receiver_count = i + 1;
+      break;
+    }
+    printf("%s\n", receivers[i].path);
+    ++i;
+  }
+  fflush(stdout);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = &on_signal;
+  sigaction(SIGINT, &action, 0);
+  sigaction(SIGTERM, &action, 0);
+
+  const unsigned long long int start = now_ns();
+  unsigned long long int loop_start = start;
+  unsigned long long int report = start + NS_PER_S;
+  unsigned long long int sentences = 0;
+  unsigned long long int bytes = 0;
+  unsigned long long int reported_sentences = 0;
+  unsigned long long int reported_bytes = 0;
+  unsigned long long int lag = 0;
+  unsigned long int loop = 0;
+  while ((rc == 0) && (stop == 0) && ((loops == 0) || (loop < loops))) {
+    size_t written = 0;
+    size_t c = 0;
+    while ((stop == 0) && (c <= s.count)) {
+      /* the last write is anything after the last sentence */
+      const size_t end = (c < s.count) ? s.chunks[c].end : m.len;
+      if (c < s.count) {
+        const unsigned long long int due = loop_start + s.chunks[c].at;
+        if (due > now_ns()) {
+          sleep_until(due);
+        }
+        /* how late the sentence is, only meaningful when paced */
+        const unsigned long long int now = now_ns();
+        if ((s.ns_per_s > 0) && (now > due) && ((now - due) > lag)) {
+          lag = now - due;
+        }
+        sentences += (unsigned long long int)s.chunks[c].sentences *
+                     receiver_count;
+      } else {
+        sentences +=
+            (unsigned long long int)count_sentences(&m.buf[written],
+                                                    end - written) *
+            receiver_count;
+      }
+      i = 0;
+      while ((end > written) && (i < receiver_count)) {
+        write_receiver(&receivers[i], &m.buf[written], end - written);
+        ++i;
+      }
+      bytes += (end - written) * receiver_count;
+      written = end;
+      ++c;
+
+      const unsigned long long int now = now_ns();
+      if (now >= report) {
+        unsigned long long int dropped = 0;
+        i = 0;
+        while (i < receiver_count) {
+          dropped += receivers[i].dropped;
+          ++i;
+        }
+        const double seconds = (double)(now - report + NS_PER_S) / 1e9;
+        printf("%.0f s: %.0f sentences/s, %.0f bytes/s, %llu bytes dropped, "
+               "%.3f ms max lag\n",
+               (double)(now - start) / 1e9,
+               (double)(sentences - reported_sentences) / seconds,
+               (double)(bytes - reported_bytes) / seconds, dropped,
+               (double)lag / 1e6);
+        fflush(stdout);
+        reported_sentences = sentences;
+        reported_bytes = bytes;
+        lag = 0;
+        report = now + NS_PER_S;
+      }
+    }
+    loop_start += loop_ns;
+    ++loop;
+  }
+
+  const double seconds = (double)(now_ns() - start) / 1e9;
+  const unsigned long long int deadline = now_ns() + NS_PER_S;
+  unsigned long long int dropped = 0;
+  i = 0;
+  while (i < receiver_count) {
+    drain_receiver(&receivers[i], deadline);
+    dropped += receivers[i].dropped;
+    close_receiver(&receivers[i]);
+    ++i;
+  }
+  printf("total: %llu sentences, %llu bytes in %.3f s, %.0f sentences/s, "
+         "%.0f bytes/s, %llu bytes dropped\n",
+         sentences, bytes, seconds, (double)sentences / seconds,
+         (double)bytes / seconds, dropped);
+  free(receivers);
+  free(s.chunks);
+  nmea_mmap_close(&m);
+  return rc;
+}
@@ -13,15 +13,149 @@
  * limitations under the License.
  */
 
+#if defined(NMEA_LATENCY)
+/* must be defined before any system headers are included, for clock_gettime */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#endif
+
 #include "nmea.h"
 
 #include <limits.h>
 #include <string.h>
 
+#if defined(NMEA_STATS)
+#include <stddef.h>
+#include <stdio.h>
+#endif
+
+#if defined(NMEA_LATENCY)
+#include <time.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* the statistics compile out entirely without NMEA_STATS */
+#if defined(NMEA_STATS)
+#define STATS_ADD(n, counter, v) ((n)->stats.counter += (v))
+#define STATS_CHECKSUM(n, pass) stats_checksum(n, pass)
+#define STATS_FIELD_END(n, field, kind) stats_field_end(n, field, kind)
+#else
+#define STATS_ADD(n, counter, v) ((void)0)
+#define STATS_CHECKSUM(n, pass) ((void)0)
+#define STATS_FIELD_END(n, field, kind) ((void)0)
+#endif
+
+/* as are the latency histograms without NMEA_LATENCY */
+#if defined(NMEA_LATENCY)
+#define LATENCY_START(n) ((n)->latency.start = latency_now())
+#define LATENCY_END(n) latency_end(n)
+#else
+#define LATENCY_START(n) ((void)0)
+#define LATENCY_END(n) ((void)0)
+#endif
+
 static const unsigned long int SECONDS_IN_MINUTE = 60;
 static const unsigned long int SECONDS_IN_HOUR = 3600;
 static const unsigned long int SECONDS_IN_DAY = 86400;
 
+#if defined(NMEA_FXP_DEFERRED)
+/* The integer and fractional digits are accumulated separately and only
+ * converted to fixed point when the field ends. The fractional digits are
+ * scaled by 2^64 / 10^digits, from a table of the reciprocals as 64.64 fixed
+ * point, index 0 is for 1 digit. More digits than this are ignored. */
+static const unsigned char FRAC_DIGITS_MAX = 19;
+
+static const unsigned long long int POW10_RECIPROCALS[][2] = {
+    {0x1999999999999999ull, 0x9999999999999999ull},
+    {0x028f5c28f5c28f5cull, 0x28f5c28f5c28f5c2ull},
+    {0x004189374bc6a7efull, 0x9db22d0e56041893ull},
+    {0x00068db8bac710cbull, 0x295e9e1b089a0275ull},
+    {0x0000a7c5ac471b47ull, 0x84230fcf80dc3372ull},
+    {0x000010c6f7a0b5edull, 0x8d36b4c7f3493858ull},
+    {0x000001ad7f29abcaull, 0xf485787a6520ec08ull},
+    {0x0000002af31dc461ull, 0x1873bf3f70834acdull},
+    {0x000000044b82fa09ull, 0xb5a52cb98b405447ull},
+    {0x000000006df37f67ull, 0x5ef6eadf5ab9a207ull},
+    {0x000000000afebff0ull, 0xbcb24aafef78f69aull},
+    {0x0000000001197998ull, 0x12dea11197f27f0full},
+    {0x00000000001c25c2ull, 0x68497681c2650cb4ull},
+    {0x000000000002d093ull, 0x70d42573603d4e12ull},
+    {0x000000000000480eull, 0xbe7b9d58566c87ceull},
+    {0x0000000000000734ull, 0xaca5f6226f0ada61ull},
+    {0x00000000000000b8ull, 0x77aa3236a4b44909ull},
+    {0x0000000000000012ull, 0x725dd1d243aba0e7ull},
+    {0x0000000000000001ull, 0xd83c94fb6d2ac34aull}};
+
+static const unsigned int ULL_BITS = sizeof(unsigned long long int) * CHAR_BIT;
+
+/* high half of the 128 bit product of a and b */
+static unsigned long long int mul_hi(const unsigned long long int a,
+                                     const unsigned long long int b) {
+  const unsigned long long int mask = 0xffffffffull;
+  const unsigned long long int al = a & mask;
+  const unsigned long long int ah = a >> 32;
+  const unsigned long long int bl = b & mask;
+  const unsigned long long int bh = b >> 32;
+  const unsigned long long int mid = ((al * bl) >> 32) + ((ah * bl) & mask) +
+                                     (al * bh & mask);
+  return (ah * bh) + ((ah * bl) >> 32) + ((al * bh) >> 32) + (mid >> 32);
+}
+
+static void ufxp_init(struct nmea_fxp_state *const state) {
+  state->val = 0;
+  state->frac = 0;
+  state->frac_digits = 0;
+  state->dp = 0;
+}
+
+/* q is unused, the conversion is done by ufxp_get_val */
+static void ufxp_from_ascii(struct nmea_fxp_state *const state, const char c,
+                            const unsigned char q) {
+  (void)q;
+  if (c == '.') {
+    state->dp = 1;
+  } else {
+    unsigned long long int digit = c - '0';
+    if (state->dp == 0) {
+      if (state->val < (ULLONG_MAX / 10)) {
+        state->val = (state->val * 10) + digit;
+      } else {
+        state->val = ULLONG_MAX;
+      }
+    } else if (state->frac_digits < FRAC_DIGITS_MAX) {
+      state->frac = (state->frac * 10) + digit;
+      ++state->frac_digits;
+    }
+  }
+}
+
+/* q is the number of fractional bits */
+static unsigned long long int
+ufxp_get_val(const struct nmea_fxp_state *const state, const unsigned char q) {
+  if (q == 0) {
+    return state->val;
+  }
+  if ((state->val >> (ULL_BITS - q)) != 0) {
+    return ULLONG_MAX;
+  }
+  unsigned long long int val = state->val << q;
+  if (state->frac_digits != 0) {
+    /* frac / 10^digits as a 0.64 fixed point value */
+    const unsigned long long int *const r =
+        POW10_RECIPROCALS[state->frac_digits - 1];
+    const unsigned long long int frac =
+        (state->frac * r[0]) + mul_hi(state->frac, r[1]);
+    val += frac >> (ULL_BITS - q);
+  }
+  return val;
+}
+#else
 static int check_post_multiply(const size_t a, const size_t b, const size_t q) {
   return ((b != 0) && ((q / b) != a)) ? -1 : 0;
 }
@@ -47,13 +181,20 @@ static void ufxp_from_ascii(struct nmea_fxp_state *const state, const char c,
   } else {
     unsigned long long int inc = ((unsigned long long int)(c - '0')) << q;
     if (state->dp == 0) {
-      state->val *= 10;
-      state->val += inc;
-      if (state->val < inc) {
+      /* saturate rather than wrap on both the multiply and the add */
+      if (state->val <= (ULLONG_MAX / 10)) {
+        state->val *= 10;
+        state->val += inc;
+        if (state->val < inc) {
+          state->val = ULLONG_MAX;
+        }
+      } else {
         state->val = ULLONG_MAX;
       }
     } else {
-      state->val += inc / state->div;
+      const unsigned long long int frac = inc / state->div;
+      state->val = (state->val > (ULLONG_MAX - frac)) ? ULLONG_MAX
+                                                      : (state->val + frac);
       if (check_multiply(&state->div, 10, state->div) != 0) {
         state->div = ULLONG_MAX;
       }
@@ -63,9 +204,16 @@ static void ufxp_from_ascii(struct nmea_fxp_state *const state, const char c,
 }
 
 static unsigned long long int
-ufxp_get_val(const struct nmea_fxp_state *const state) {
+ufxp_get_val(const struct nmea_fxp_state *const state, const unsigned char q) {
+  (void)q;
   return state->val;
 }
+#endif
+
+static unsigned long long int
+ui_get_val(const struct nmea_fxp_state *const state) {
+  return ufxp_get_val(state, 0);
+}
 
 static void fxp_init(struct nmea_fxp_state *const state) {
   state->neg = 0;
@@ -81,8 +229,9 @@ static void fxp_from_ascii(struct nmea_fxp_state *const state, const char c,
   }
 }
 
-static long long int fxp_get_val(const struct nmea_fxp_state *const state) {
-  unsigned long long int usval = ufxp_get_val(state);
+static long long int fxp_get_val(const struct nmea_fxp_state *const state,
+                                 const unsigned char q) {
+  unsigned long long int usval = ufxp_get_val(state, q);
   long long int val = (usval > LLONG_MAX) ? LLONG_MAX : (long long int)usval;
   return (state->neg != 0) ? -val : val;
 }
@@ -135,8 +284,9 @@ static void longitude_char_handler(struct nmea *const n,
 
 static void longitude_end_handler(struct nmea *const n) {
   n->state.scratch <<= NMEA_FXP_FRACTIONALS[NMEA_FIELD_LONGITUDE];
-  n->data.longitude =
-      n->state.scratch + (ufxp_get_val(&n->state.fxpse.fxp) / 60);
+  unsigned long long int minutes = ufxp_get_val(
+      &n->state.fxpse.fxp, NMEA_FXP_FRACTIONALS[NMEA_FIELD_LONGITUDE]);
+  n->data.longitude = n->state.scratch + (minutes / 60);
 }
 
 static void latitude_start_handler(struct nmea *const n) {
@@ -152,8 +302,9 @@ void latitude_char_handler(struct nmea *const n,
 
 void latitude_end_handler(struct nmea *const n) {
   n->state.scratch <<= NMEA_FXP_FRACTIONALS[NMEA_FIELD_LATITUDE];
-  n->data.latitude =
-      n->state.scratch + (ufxp_get_val(&n->state.fxpse.fxp) / 60);
+  unsigned long long int minutes = ufxp_get_val(
+      &n->state.fxpse.fxp, NMEA_FXP_FRACTIONALS[NMEA_FIELD_LATITUDE]);
+  n->data.latitude = n->state.scratch + (minutes / 60);
 }
 
 static void latitude_dir_char_handler(struct nmea *const n, const char c) {
@@ -175,15 +326,15 @@ static void longitude_dir_char_handler(struct nmea *const n, const char c) {
 }
 
 static void fix_quality_end_handler(struct nmea *const n) {
-  n->data.fix_quality = ufxp_get_val(&n->state.fxpse.fxp);
+  n->data.fix_quality = ui_get_val(&n->state.fxpse.fxp);
 }
 
 static void satellites_tracked_end_handler(struct nmea *const n) {
-  n->data.satellites_tracked = ufxp_get_val(&n->state.fxpse.fxp);
+  n->data.satellites_tracked = ui_get_val(&n->state.fxpse.fxp);
 }
 
 static void satellites_in_view_end_handler(struct nmea *const n) {
-  n->data.satellites_in_view = ufxp_get_val(&n->state.fxpse.fxp);
+  n->data.satellites_in_view = ui_get_val(&n->state.fxpse.fxp);
 }
 
 static void altitude_char_handler(struct nmea *const n, const char c) {
@@ -192,7 +343,8 @@ static void altitude_char_handler(struct nmea *const n, const char c) {
 }
 
 static void altitude_end_handler(struct nmea *const n) {
-  n->data.altitude = fxp_get_val(&n->state.fxpse.fxp);
+  n->data.altitude = fxp_get_val(&n->state.fxpse.fxp,
+                                 NMEA_FXP_FRACTIONALS[NMEA_FIELD_ALTITUDE]);
 }
 
 static void geoid_height_char_handler(struct nmea *const n, const char c) {
@@ -201,15 +353,16 @@ static void geoid_height_char_handler(struct nmea *const n, const char c) {
 }
 
 static void geoid_height_end_handler(struct nmea *const n) {
-  n->data.geoid_height = fxp_get_val(&n->state.fxpse.fxp);
+  n->data.geoid_height = fxp_get_val(
+      &n->state.fxpse.fxp, NMEA_FXP_FRACTIONALS[NMEA_FIELD_GEOID_HEIGHT]);
 }
 
 static void fix_3d_end_handler(struct nmea *const n) {
-  n->data.fix_3d = ufxp_get_val(&n->state.fxpse.fxp);
+  n->data.fix_3d = ui_get_val(&n->state.fxpse.fxp);
 }
 
 static void prns_tracked_end_handler(struct nmea *const n) {
-  unsigned char prn = ufxp_get_val(&n->state.fxpse.fxp);
+  unsigned char prn = ui_get_val(&n->state.fxpse.fxp);
   unsigned char gsa_satellite_index = n->state.gsa_satellite_index;
   if ((prn != 0) && (gsa_satellite_index < NMEA_MAX_PRNS_TRACKED)) {
     /* prns are 1 relative */
@@ -225,7 +378,8 @@ static void pdop_char_handler(struct nmea *const n, const char c) {
 }
 
 static void pdop_end_handler(struct nmea *const n) {
-  n->data.pdop = ufxp_get_val(&n->state.fxpse.fxp);
+  n->data.pdop = ufxp_get_val(&n->state.fxpse.fxp,
+                              NMEA_FXP_FRACTIONALS[NMEA_FIELD_PDOP]);
 }
 
 static void hdop_char_handler(struct nmea *const n, const char c) {
@@ -234,7 +388,8 @@ static void hdop_char_handler(struct nmea *const n, const char c) {
 }
 
 static void hdop_end_handler(struct nmea *const n) {
-  n->data.hdop = ufxp_get_val(&n->state.fxpse.fxp);
+  n->data.hdop = ufxp_get_val(&n->state.fxpse.fxp,
+                              NMEA_FXP_FRACTIONALS[NMEA_FIELD_HDOP]);
 }
 
 static void vdop_char_handler(struct nmea *const n, const char c) {
@@ -243,7 +398,8 @@ static void vdop_char_handler(struct nmea *const n, const char c) {
 }
 
 static void vdop_end_handler(struct nmea *const n) {
-  n->data.vdop = ufxp_get_val(&n->state.fxpse.fxp);
+  n->data.vdop = ufxp_get_val(&n->state.fxpse.fxp,
+                              NMEA_FXP_FRACTIONALS[NMEA_FIELD_VDOP]);
 }
 
 static void gll_active_char_handler(struct nmea *const n, const char c) {
@@ -262,7 +418,8 @@ static void speed_char_handler(struct nmea *const n, const char c) {
 }
 
 static void speed_end_handler(struct nmea *const n) {
-  n->data.speed = ufxp_get_val(&n->state.fxpse.fxp);
+  n->data.speed = ufxp_get_val(&n->state.fxpse.fxp,
+                               NMEA_FXP_FRACTIONALS[NMEA_FIELD_SPEED]);
 }
 
 static void time_char_handler(struct nmea *const n, const char c) {
@@ -298,64 +455,53 @@ static void time_end_handler(struct nmea *const n) {
   n->data.time += n->state.scratch;
 }
 
-static void date_char_handler(struct nmea *const n, const char c) {
-  static const unsigned char month_days[] = {31, 28, 31, 30, 31, 30,
-                                             31, 31, 30, 31, 30};
+static void date_start_handler(struct nmea *const n) {
+  n->state.char_count = 0;
+  n->state.scratch = 0;
+}
 
-  unsigned long long int digit = c - '0';
-  switch (n->state.char_count) {
-  case 0: /* days e10 */
-    n->state.scratch = digit * 10 * SECONDS_IN_DAY;
-    break;
-  case 1: /* days */
-    n->state.scratch += digit * SECONDS_IN_DAY;
-    n->state.scratch -= SECONDS_IN_DAY;
-    break;
-  case 2: /* months e10 */
-    n->state.fxpse.se.scratch[0] = digit * 10;
-    break;
-  case 3:                                  /* months */
-    n->state.fxpse.se.scratch[0] += digit; /* one relative */
-    --n->state.fxpse.se.scratch[0]; /* how many months worth of days to add */
-    if (n->state.fxpse.se.scratch[0] >
-        (sizeof(month_days) / sizeof(month_days[0]))) {
-      /* months > 12 */
-      break;
-    }
-    unsigned char i = 0;
-    while (i < n->state.fxpse.se.scratch[0]) {
-      n->state.scratch += (month_days[i] * SECONDS_IN_DAY);
-      ++i;
-    }
-    break;
-  case 4: /* years e10 */
-    n->state.fxpse.se.scratch[1] = digit * 10;
-    break;
-  case 5: /* years */
-    n->state.fxpse.se.scratch[1] += digit;
-    /* this also adds the leap day for this year, removed below if earlier than
-     * Mar */
-    n->state.scratch += (n->state.fxpse.se.scratch[1] * SECONDS_IN_DAY * 365) +
-                        SECONDS_IN_DAY * (n->state.fxpse.se.scratch[1] / 4);
-    if ((NMEA_CENTURY % 400) == 0) {
-      /* century is leap year */
-      n->state.scratch += SECONDS_IN_DAY;
-    }
-    /* remove 29th Feb for this year if earlier than Mar */
-    if (((n->state.fxpse.se.scratch[1] % 4) == 0) &&
-        (n->state.fxpse.se.scratch[0] < 3)) {
-      n->state.scratch -= SECONDS_IN_DAY;
-    }
-    break;
-  default:
-    break;
+/* packs the DDMMYY digits into a decimal integer */
+static void date_char_handler(struct nmea *const n, const char c) {
+  if (n->state.char_count < 6) {
+    n->state.scratch = (n->state.scratch * 10) + (c - '0');
   }
   ++n->state.char_count;
 }
 
+/* days since 1970-01-01 of a proleptic Gregorian date, the leap day of the
+ * year itself is only counted from March, so the year is taken as ending
+ * before it */
+static long int days_from_civil(const unsigned long int year,
+                                const unsigned char month,
+                                const unsigned char day) {
+  static const unsigned short int days_before_month[] = {
+      0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+  /* days_from_civil(1970, 1, 1) without the subtraction */
+  static const unsigned long int epoch_days = 719527;
+  const unsigned long int y = year - ((month < 3) ? 1 : 0);
+  return (long int)((year * 365) + (y / 4) - (y / 100) + (y / 400) +
+                    days_before_month[month - 1] + day - 1) -
+         (long int)epoch_days;
+}
+
 static void date_end_handler(struct nmea *const n) {
-  n->data.time =
-      (n->data.time % SECONDS_IN_DAY) + NMEA_CENTURY_OFFSET + n->state.scratch;
+  const unsigned long int ddmmyy = n->state.scratch;
+  struct nmea_date_cache *const cache = &n->state.date_cache;
+  if (n->state.char_count != 6) {
+    return;
+  }
+  /* the date changes once a day, so is usually the same as last time */
+  if (ddmmyy != cache->ddmmyy) {
+    const unsigned char day = ddmmyy / 10000;
+    const unsigned char month = (ddmmyy / 100) % 100;
+    if ((month < 1) || (month > 12) || (day < 1) || (day > 31)) {
+      return;
+    }
+    cache->ddmmyy = ddmmyy;
+    cache->days = days_from_civil(cache->century + (ddmmyy % 100), month, day);
+  }
+  n->data.time = (n->data.time % SECONDS_IN_DAY) +
+                 ((long long int)cache->days * SECONDS_IN_DAY);
 }
 
 static void magnetic_variation_char_handler(struct nmea *const n,
@@ -365,7 +511,8 @@ static void magnetic_variation_char_handler(struct nmea *const n,
 }
 
 static void magnetic_variation_end_handler(struct nmea *const n) {
-  n->data.magnetic_variation = fxp_get_val(&n->state.fxpse.fxp);
+  n->data.magnetic_variation = fxp_get_val(
+      &n->state.fxpse.fxp, NMEA_FXP_FRACTIONALS[NMEA_FIELD_MAGNETIC_VARIATION]);
 }
 
 static void magnetic_variation_dir_char_handler(struct nmea *const n,
@@ -380,11 +527,11 @@ static void magnetic_variation_dir_char_handler(struct nmea *const n,
 }
 
 static void gsv_sentences_total_end_handler(struct nmea *const n) {
-  n->state.gsv_sentences_total = ufxp_get_val(&n->state.fxpse.fxp);
+  n->state.gsv_sentences_total = ui_get_val(&n->state.fxpse.fxp);
 }
 
 static void sentence_no_end_handler(struct nmea *const n) {
-  n->state.gsv_sentence_no = ufxp_get_val(&n->state.fxpse.fxp);
+  n->state.gsv_sentence_no = ui_get_val(&n->state.fxpse.fxp);
 }
 
 static void prn_end_handler(struct nmea *const n) {
@@ -392,7 +539,7 @@ static void prn_end_handler(struct nmea *const n) {
   if (gsv_satellite_index >= NMEA_MAX_SATS) {
     return;
   }
-  n->data.sats[gsv_satellite_index].prn = ufxp_get_val(&n->state.fxpse.fxp);
+  n->data.sats[gsv_satellite_index].prn = ui_get_val(&n->state.fxpse.fxp);
 }
 
 static void azimuth_end_handler(struct nmea *const n) {
@@ -400,7 +547,7 @@ static void azimuth_end_handler(struct nmea *const n) {
   if (gsv_satellite_index >= NMEA_MAX_SATS) {
     return;
   }
-  n->data.sats[gsv_satellite_index].azimuth = ufxp_get_val(&n->state.fxpse.fxp);
+  n->data.sats[gsv_satellite_index].azimuth = ui_get_val(&n->state.fxpse.fxp);
 }
 
 static void elevation_end_handler(struct nmea *const n) {
@@ -409,7 +556,7 @@ static void elevation_end_handler(struct nmea *const n) {
     return;
   }
   n->data.sats[gsv_satellite_index].elevation =
-      ufxp_get_val(&n->state.fxpse.fxp);
+      ui_get_val(&n->state.fxpse.fxp);
 }
 
 static void snr_end_handler(struct nmea *const n) {
@@ -417,7 +564,7 @@ static void snr_end_handler(struct nmea *const n) {
   if (gsv_satellite_index >= NMEA_MAX_SATS) {
     return;
   }
-  n->data.sats[gsv_satellite_index].snr = ufxp_get_val(&n->state.fxpse.fxp);
+  n->data.sats[gsv_satellite_index].snr = ui_get_val(&n->state.fxpse.fxp);
   ++n->state.gsv_satellite_index;
   n->state.gsv_satellite_count = n->state.gsv_satellite_index;
 }
@@ -428,7 +575,8 @@ static void true_track_char_handler(struct nmea *n, const char c) {
 }
 
 static void true_track_end_handler(struct nmea *n) {
-  n->data.true_track = fxp_get_val(&n->state.fxpse.fxp);
+  n->data.true_track = fxp_get_val(&n->state.fxpse.fxp,
+                                   NMEA_FXP_FRACTIONALS[NMEA_FIELD_TRUE_TRACK]);
 }
 
 static void magnetic_track_char_handler(struct nmea *n, const char c) {
@@ -437,7 +585,8 @@ static void magnetic_track_char_handler(struct nmea *n, const char c) {
 }
 
 static void magnetic_track_end_handler(struct nmea *n) {
-  n->data.magnetic_track = fxp_get_val(&n->state.fxpse.fxp);
+  n->data.magnetic_track = fxp_get_val(
+      &n->state.fxpse.fxp, NMEA_FXP_FRACTIONALS[NMEA_FIELD_MAGNETIC_TRACK]);
 }
 
 static void header_start_handler(struct nmea *const n);
@@ -490,7 +639,7 @@ static const struct nmea_field_handlers HANDLER_LUT[] = {
                           &speed_end_handler},
     [NMEA_FIELD_TIME] = {&reset_cc_start_handler, &time_char_handler,
                          &time_end_handler},
-    [NMEA_FIELD_DATE] = {&reset_cc_start_handler, &date_char_handler,
+    [NMEA_FIELD_DATE] = {&date_start_handler, &date_char_handler,
                          &date_end_handler},
     [NMEA_FIELD_MAGNETIC_VARIATION] = {&fxp_init_start_handler,
                                        &magnetic_variation_char_handler,
@@ -519,6 +668,150 @@ static const struct nmea_field_handlers HANDLER_LUT[] = {
     [NMEA_FIELD_HEADER] = {&header_start_handler, &header_char_handler,
                            &header_end_handler}};
 
+/* The char handlers grouped by the kind of field they parse, used by the switch
+ * dispatch to call them directly so that they can be inlined. The fixed point
+ * kinds take their Q format from NMEA_FXP_FRACTIONALS. */
+enum field_kind {
+  FIELD_KIND_IGNORE = 0,
+  FIELD_KIND_UFXP,
+  FIELD_KIND_FXP,
+  FIELD_KIND_LON_LAT,
+  FIELD_KIND_TIME,
+  FIELD_KIND_DATE,
+  FIELD_KIND_DIR,
+  FIELD_KIND_HEADER,
+  FIELD_KIND_RECORD /* recorded for lazy decoding */
+};
+
+static const unsigned char FIELD_KIND_LUT[] = {
+    [NMEA_FIELD_LONGITUDE] = FIELD_KIND_LON_LAT,
+    [NMEA_FIELD_LONGITUDE_DIR] = FIELD_KIND_DIR,
+    [NMEA_FIELD_LATITUDE_DIR] = FIELD_KIND_DIR,
+    [NMEA_FIELD_LATITUDE] = FIELD_KIND_LON_LAT,
+    [NMEA_FIELD_FIX_QUALITY] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_SATELLITES_TRACKED] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_SATELLITES_IN_VIEW] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_ALTITUDE] = FIELD_KIND_FXP,
+    [NMEA_FIELD_GEOID_HEIGHT] = FIELD_KIND_FXP,
+    [NMEA_FIELD_FIX_3D] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_PRNS_TRACKED] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_PRN] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_PDOP] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_HDOP] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_VDOP] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_GLL_ACTIVE] = FIELD_KIND_DIR,
+    [NMEA_FIELD_RMC_ACTIVE] = FIELD_KIND_DIR,
+    [NMEA_FIELD_SPEED] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_TIME] = FIELD_KIND_TIME,
+    [NMEA_FIELD_DATE] = FIELD_KIND_DATE,
+    [NMEA_FIELD_MAGNETIC_VARIATION] = FIELD_KIND_FXP,
+    [NMEA_FIELD_MAGNETIC_VARIATION_DIR] = FIELD_KIND_DIR,
+    [NMEA_FIELD_IGNORE] = FIELD_KIND_IGNORE,
+    [NMEA_FIELD_GSV_SENTENCES_TOTAL] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_SENTENCE_NO] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_AZIMUTH] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_ELEVATION] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_SNR] = FIELD_KIND_UFXP,
+    [NMEA_FIELD_TRUE_TRACK] = FIELD_KIND_FXP,
+    [NMEA_FIELD_MAGNETIC_TRACK] = FIELD_KIND_FXP,
+    [NMEA_FIELD_HEADER] = FIELD_KIND_HEADER};
+
+#if defined(NMEA_SWITCH_DISPATCH)
+static void dir_char_handler(struct nmea *const n, const enum nmea_fields field,
+                             const char c) {
+  switch (field) {
+  case NMEA_FIELD_LONGITUDE_DIR:
+    longitude_dir_char_handler(n, c);
+    break;
+  case NMEA_FIELD_LATITUDE_DIR:
+    latitude_dir_char_handler(n, c);
+    break;
+  case NMEA_FIELD_GLL_ACTIVE:
+    gll_active_char_handler(n, c);
+    break;
+  case NMEA_FIELD_RMC_ACTIVE:
+    rmc_active_char_handler(n, c);
+    break;
+  case NMEA_FIELD_MAGNETIC_VARIATION_DIR:
+    magnetic_variation_dir_char_handler(n, c);
+    break;
+  default:
+    break;
+  }
+}
+#endif
+
+#if defined(NMEA_LAZY_DECODE)
+static void lazy_start_handler(struct nmea *const n) {
+  if (n->lazy.count < NMEA_LAZY_MAX_FIELDS) {
+    n->lazy.offsets[n->lazy.count] = n->lazy.len;
+  }
+}
+
+static void lazy_record(struct nmea *const n, const char *const p,
+                        const size_t len) {
+  const size_t space = NMEA_LAZY_MAX_CHARS - n->lazy.len;
+  const size_t l = (len < space) ? len : space;
+  memcpy(&n->lazy.buf[n->lazy.len], p, l);
+  n->lazy.len += l;
+}
+
+static void lazy_char_handler(struct nmea *const n, const char c) {
+  lazy_record(n, &c, 1);
+}
+
+static void lazy_end_handler(struct nmea *const n) {
+  if (n->lazy.count < NMEA_LAZY_MAX_FIELDS) {
+    n->lazy.lengths[n->lazy.count] =
+        n->lazy.len - n->lazy.offsets[n->lazy.count];
+    ++n->lazy.count;
+  }
+}
+
+static const struct nmea_field_handlers LAZY_HANDLERS = {
+    &lazy_start_handler, &lazy_char_handler, &lazy_end_handler};
+#endif
+
+/* passes c to the char handler of the current field */
+static inline void field_char(struct nmea *const n, const char c) {
+#if defined(NMEA_SWITCH_DISPATCH)
+  const enum nmea_fields field = n->state.field;
+  switch (n->state.field_kind) {
+  case FIELD_KIND_UFXP:
+    ufxp_from_ascii(&n->state.fxpse.fxp, c, NMEA_FXP_FRACTIONALS[field]);
+    break;
+  case FIELD_KIND_FXP:
+    fxp_from_ascii(&n->state.fxpse.fxp, c, NMEA_FXP_FRACTIONALS[field]);
+    break;
+  case FIELD_KIND_LON_LAT:
+    lon_lat_char_handler(n, c, (field == NMEA_FIELD_LONGITUDE) ? 3 : 2,
+                         NMEA_FXP_FRACTIONALS[field]);
+    break;
+  case FIELD_KIND_TIME:
+    time_char_handler(n, c);
+    break;
+  case FIELD_KIND_DATE:
+    date_char_handler(n, c);
+    break;
+  case FIELD_KIND_DIR:
+    dir_char_handler(n, field, c);
+    break;
+  case FIELD_KIND_HEADER:
+    header_char_handler(n, c);
+    break;
+#if defined(NMEA_LAZY_DECODE)
+  case FIELD_KIND_RECORD:
+    lazy_char_handler(n, c);
+    break;
+#endif
+  default:
+    break;
+  }
+#else
+  n->state.field_handlers->char_handler(n, c);
+#endif
+}
+
 static const enum nmea_fields GGA_FIELDS[] = {NMEA_FIELD_TIME,
                                               NMEA_FIELD_LATITUDE,
                                               NMEA_FIELD_LATITUDE_DIR,
@@ -585,10 +878,26 @@ static const enum nmea_fields VTG_FIELDS[] = {
     NMEA_FIELD_IGNORE,     NMEA_FIELD_SPEED,  NMEA_FIELD_IGNORE,
     NMEA_FIELD_IGNORE,     NMEA_FIELD_IGNORE, NMEA_FIELD_IGNORE};
 
+static void sentence_complete(struct nmea *const n,
+                              const nmea_field_bitmap_t fields);
+
 static void gsa_start_handler(struct nmea *const n) {
   n->state.gsa_satellite_index = 0;
 }
 
+static void gsv_start_handler(struct nmea *const n) {
+  /* a set of GSV sentences comes from a single talker, abandon any partial set
+   * from another */
+  if (n->data.talker != n->state.gsv_talker) {
+    if (n->state.gsv_sentences_received != 0) {
+      STATS_ADD(n, gsv_sets_abandoned, 1);
+    }
+    n->state.gsv_sentences_received = 0;
+    n->state.gsv_satellite_index = 0;
+    n->state.gsv_talker = n->data.talker;
+  }
+}
+
 static void gsv_end_handler(struct nmea *const n) {
   /* update GSV_sentences_received */
   unsigned int gsv_sentence_no = n->state.gsv_sentence_no;
@@ -600,97 +909,422 @@ static void gsv_end_handler(struct nmea *const n) {
   if (n->state.gsv_sentences_received ==
       ((((nmea_gsv_bitmap_t)1) << n->state.gsv_sentences_total) - 1)) {
     /* all GSV messages received */
-    n->state.received |= n->state.field_bitmap;
+    n->state.received |= n->state.field_bitmap & ~NMEA_FIELD_IGNORE_MASK;
+    sentence_complete(n, n->state.field_bitmap & ~NMEA_FIELD_IGNORE_MASK);
     n->state.gsv_sentences_received = 0;
     n->state.gsv_satellite_index = 0;
   }
 }
 
 static void gsv_checksum_fail_handler(struct nmea *const n) {
+  if (n->state.gsv_sentences_received != 0) {
+    STATS_ADD(n, gsv_sets_abandoned, 1);
+  }
   n->state.gsv_sentences_received = 0;
   n->state.gsv_satellite_index = 0;
 }
 
 static void generic_end_handler(struct nmea *const n) {
-  n->state.received |= n->state.field_bitmap;
+#if defined(NMEA_LAZY_DECODE)
+  if (n->state.sentence == n->lazy.sentence) {
+    n->lazy.pending = n->state.field_bitmap;
+  }
+#endif
+  /* ignored fields are never flagged, so skipping an ignored sentence without
+   * parsing it leaves the same flags as parsing it */
+  n->state.received |= n->state.field_bitmap & ~NMEA_FIELD_IGNORE_MASK;
+  sentence_complete(n, n->state.field_bitmap & ~NMEA_FIELD_IGNORE_MASK);
 }
 
 static const struct nmea_sentence_format SENTENCE_LUT[] = {
-    {GGA_FIELDS, ignore_handler, generic_end_handler, ignore_handler, "GPGGA",
-     sizeof(GGA_FIELDS) / sizeof(GGA_FIELDS[0])},
-    {GLL_FIELDS, ignore_handler, generic_end_handler, ignore_handler, "GPGLL",
-     sizeof(GLL_FIELDS) / sizeof(GLL_FIELDS[0])},
-    {GSA_FIELDS, gsa_start_handler, generic_end_handler, ignore_handler,
-     "GPGSA", sizeof(GSA_FIELDS) / sizeof(GSA_FIELDS[0])},
-    {GSV_FIELDS, ignore_handler, gsv_end_handler, gsv_checksum_fail_handler,
-     "GPGSV", sizeof(GSV_FIELDS) / sizeof(GSV_FIELDS[0])},
-    {RMC_FIELDS, ignore_handler, generic_end_handler, ignore_handler, "GPRMC",
-     sizeof(RMC_FIELDS) / sizeof(RMC_FIELDS[0])},
-    {VTG_FIELDS, ignore_handler, generic_end_handler, ignore_handler, "GPVTG",
-     sizeof(VTG_FIELDS) / sizeof(VTG_FIELDS[0])}};
+    [NMEA_SENTENCE_GGA] = {GGA_FIELDS, ignore_handler, generic_end_handler,
+                           ignore_handler, "GGA",
+                           sizeof(GGA_FIELDS) / sizeof(GGA_FIELDS[0])},
+    [NMEA_SENTENCE_GLL] = {GLL_FIELDS, ignore_handler, generic_end_handler,
+                           ignore_handler, "GLL",
+                           sizeof(GLL_FIELDS) / sizeof(GLL_FIELDS[0])},
+    [NMEA_SENTENCE_GSA] = {GSA_FIELDS, gsa_start_handler, generic_end_handler,
+                           ignore_handler, "GSA",
+                           sizeof(GSA_FIELDS) / sizeof(GSA_FIELDS[0])},
+    [NMEA_SENTENCE_GSV] = {GSV_FIELDS, gsv_start_handler, gsv_end_handler,
+                           gsv_checksum_fail_handler, "GSV",
+                           sizeof(GSV_FIELDS) / sizeof(GSV_FIELDS[0])},
+    [NMEA_SENTENCE_RMC] = {RMC_FIELDS, ignore_handler, generic_end_handler,
+                           ignore_handler, "RMC",
+                           sizeof(RMC_FIELDS) / sizeof(RMC_FIELDS[0])},
+    [NMEA_SENTENCE_VTG] = {VTG_FIELDS, ignore_handler, generic_end_handler,
+                           ignore_handler, "VTG",
+                           sizeof(VTG_FIELDS) / sizeof(VTG_FIELDS[0])}};
+
+/* calls the callbacks that want the sentence and any of the fields it set */
+static void sentence_complete(struct nmea *const n,
+                              const nmea_field_bitmap_t fields) {
+  const size_t count = n->state.callback_count;
+  if (count == 0) {
+    return;
+  }
+  const enum nmea_sentences sentence = n->state.sentence - SENTENCE_LUT;
+  const nmea_sentence_bitmap_t sentence_mask = ((nmea_sentence_bitmap_t)1)
+                                               << sentence;
+  const struct nmea_callback *const callbacks = n->state.callbacks;
+#if defined(NMEA_LAZY_DECODE)
+  nmea_field_bitmap_t decode = 0;
+  size_t i = 0;
+  while (i < count) {
+    if ((callbacks[i].sentences & sentence_mask) != 0) {
+      decode |= callbacks[i].fields & fields;
+    }
+    ++i;
+  }
+  nmea_decode(n, decode);
+#endif
+  size_t j = 0;
+  while (j < count) {
+    const struct nmea_callback *const cb = &callbacks[j];
+    if (((cb->sentences & sentence_mask) != 0) &&
+        ((cb->fields & fields) != 0)) {
+      cb->fn(&n->data, sentence, fields, cb->ctx);
+    }
+    ++j;
+  }
+}
 
 static const struct nmea_sentence_format IGNORE_SENTENCE = {
     0, ignore_handler, ignore_handler, ignore_handler, "", 0};
 
+#if defined(NMEA_STATS)
+/* counts the checksum of a supported sentence, ignored sentences aren't
+ * counted as nmea_parse_buf skips them without checking */
+static void stats_checksum(struct nmea *const n, const char pass) {
+  if (n->state.sentence == &IGNORE_SENTENCE) {
+    return;
+  }
+  if (pass != 0) {
+    ++n->stats.checksum_passes;
+    ++n->stats.sentences[n->state.sentence - SENTENCE_LUT];
+  } else {
+    ++n->stats.checksum_failures;
+  }
+}
+
+/* counts a fixed point field that saturated, before its end handler converts
+ * it */
+static void stats_field_end(struct nmea *const n, const enum nmea_fields field,
+                            const unsigned char kind) {
+  if (((kind == FIELD_KIND_UFXP) || (kind == FIELD_KIND_FXP) ||
+       (kind == FIELD_KIND_LON_LAT)) &&
+      (ufxp_get_val(&n->state.fxpse.fxp, NMEA_FXP_FRACTIONALS[field]) ==
+       ULLONG_MAX)) {
+    ++n->stats.saturations;
+  }
+}
+#endif
+
+#if defined(NMEA_LATENCY)
+static unsigned long long int latency_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((unsigned long long int)ts.tv_sec * 1000000000ull) + ts.tv_nsec;
+}
+
+/* records the time since the '$' of a supported sentence that has just passed
+ * its checksum */
+static void latency_end(struct nmea *const n) {
+  if (n->state.sentence != &IGNORE_SENTENCE) {
+    nmea_latency_record(
+        &n->latency.sentences[n->state.sentence - SENTENCE_LUT],
+        latency_now() - n->latency.start);
+  }
+}
+#endif
+
+/* a header is a 2 char talker ID followed by a 3 char sentence formatter */
+static const unsigned char HEAD_LENGTH = 5;
+
+/* the header chars are packed into an integer as they arrive, first char in
+ * the most significant byte */
+#define TALKER_PACK(a, b)                                                      \
+  ((((unsigned long int)(a)) << 8) | ((unsigned long int)(b)))
+#define FORMATTER_PACK(a, b, c)                                                \
+  ((((unsigned long int)(a)) << 16) | (((unsigned long int)(b)) << 8) |        \
+   ((unsigned long int)(c)))
+
+/* Multiplicative hash of a packed formatter into SENTENCE_HASH_LUT. The
+ * multiplier is chosen so that the hash is perfect for the formatters in
+ * SENTENCE_LUT, if a new formatter collides with an existing one then a new
+ * multiplier must be found. tests/nmea_hash_test.c checks every formatter is in
+ * its own slot. */
+#define FORMATTER_HASH(f)                                                      \
+  ((unsigned char)((((unsigned long long int)(f)) * 0x612e7696a6cecc1bull) >>  \
+                   58))
+
+/* SENTENCE_LUT index + 1 for each formatter hash, 0 if there is no sentence */
+static const unsigned char SENTENCE_HASH_LUT[64] = {
+    [FORMATTER_HASH(FORMATTER_PACK('G', 'G', 'A'))] = NMEA_SENTENCE_GGA + 1,
+    [FORMATTER_HASH(FORMATTER_PACK('G', 'L', 'L'))] = NMEA_SENTENCE_GLL + 1,
+    [FORMATTER_HASH(FORMATTER_PACK('G', 'S', 'A'))] = NMEA_SENTENCE_GSA + 1,
+    [FORMATTER_HASH(FORMATTER_PACK('G', 'S', 'V'))] = NMEA_SENTENCE_GSV + 1,
+    [FORMATTER_HASH(FORMATTER_PACK('R', 'M', 'C'))] = NMEA_SENTENCE_RMC + 1,
+    [FORMATTER_HASH(FORMATTER_PACK('V', 'T', 'G'))] = NMEA_SENTENCE_VTG + 1};
+
+static enum nmea_talker talker_from_packed(const unsigned long int talker) {
+  switch (talker) {
+  case TALKER_PACK('G', 'P'):
+    return NMEA_TALKER_GP;
+  case TALKER_PACK('G', 'L'):
+    return NMEA_TALKER_GL;
+  case TALKER_PACK('G', 'A'):
+    return NMEA_TALKER_GA;
+  case TALKER_PACK('G', 'B'):
+    return NMEA_TALKER_GB;
+  case TALKER_PACK('B', 'D'):
+    return NMEA_TALKER_BD;
+  case TALKER_PACK('G', 'Q'):
+    return NMEA_TALKER_GQ;
+  case TALKER_PACK('G', 'N'):
+    return NMEA_TALKER_GN;
+  default:
+    return NMEA_TALKER_OTHER;
+  }
+}
+
 static void field_update(struct nmea *n) {
   unsigned char comma_count = n->state.comma_count;
   if (comma_count < n->state.sentence->length) {
-    const enum nmea_fields field = n->state.sentence->fields[comma_count];
+    enum nmea_fields field = n->state.sentence->fields[comma_count];
+    if ((n->state.fields_subscribed & (((nmea_field_bitmap_t)1) << field)) ==
+        0) {
+      field = NMEA_FIELD_IGNORE;
+    }
     n->state.field = field;
+#if defined(NMEA_LAZY_DECODE)
+    /* unsubscribed fields are still recorded to keep the field indices, but are
+     * never pending so never decoded */
+    if (n->state.sentence == n->lazy.sentence) {
+      n->state.field_kind = FIELD_KIND_RECORD;
+      n->state.field_handlers = &LAZY_HANDLERS;
+      return;
+    }
+#endif
+    n->state.field_kind = FIELD_KIND_LUT[field];
     n->state.field_handlers = &HANDLER_LUT[field];
   } else {
     n->state.field = NMEA_FIELD_IGNORE;
+    n->state.field_kind = FIELD_KIND_IGNORE;
     n->state.field_handlers = &HANDLER_LUT[NMEA_FIELD_IGNORE];
   }
 }
 
+#if defined(NMEA_LAZY_DECODE)
+/* sentences with their own start or end handlers depend on their fields as
+ * they are parsed, so are always decoded eagerly */
+static char sentence_is_lazy(const struct nmea_sentence_format *const s) {
+  return ((s->start_handler == &ignore_handler) &&
+          (s->end_handler == &generic_end_handler))
+             ? 1
+             : 0;
+}
+
+static void lazy_start(struct nmea *const n) {
+  /* fields not decoded from the last sentence are lost */
+  n->state.received &= ~n->lazy.pending;
+  n->lazy.pending = 0;
+  n->lazy.sentence = n->state.sentence;
+  n->lazy.len = 0;
+  n->lazy.count = 0;
+}
+#endif
+
 static void header_start_handler(struct nmea *const n) {
   n->state.char_count = 0;
   n->state.comma_count = 0;
   n->state.checksum = 0;
   n->state.checksum_recording = 0;
-  n->state.sentence_bitmap =
-      (((nmea_sentence_bitmap_t)1)
-       << (sizeof(SENTENCE_LUT) / sizeof(SENTENCE_LUT[0]))) -
-      1;
+  n->state.scratch = 0;
 }
 
 static void header_char_handler(struct nmea *const n, const char c) {
-  unsigned char i = 0;
-  while (i < (sizeof(SENTENCE_LUT) / sizeof(SENTENCE_LUT[0]))) {
-    if (SENTENCE_LUT[i].head[n->state.char_count] != c) {
-      n->state.sentence_bitmap &= ~(((nmea_sentence_bitmap_t)1) << i);
-    }
-    ++i;
+  if (n->state.char_count < HEAD_LENGTH) {
+    n->state.scratch = (n->state.scratch << 8) | (unsigned char)c;
+  }
+  if (n->state.char_count <= HEAD_LENGTH) {
+    ++n->state.char_count;
   }
-  ++n->state.char_count;
 }
 
 static void header_end_handler(struct nmea *const n) {
-  nmea_sentence_bitmap_t oh = n->state.sentence_bitmap;
-  /* check that no more than one sentence identified */
-  if (((oh & (oh - 1)) == 0) && (oh != 0)) {
-    n->state.sentence = &SENTENCE_LUT[0];
-    while (oh != 1) {
-      ++n->state.sentence;
-      oh >>= 1;
+  /* the header is not a data field */
+  n->state.field_bitmap = 0;
+  n->state.sentence = &IGNORE_SENTENCE;
+  if (n->state.char_count != HEAD_LENGTH) {
+    STATS_ADD(n, unknown_sentences, 1);
+    return;
+  }
+  const unsigned long int formatter = n->state.scratch & 0xfffffful;
+  const unsigned char i = SENTENCE_HASH_LUT[FORMATTER_HASH(formatter)];
+  const char *const f = (i != 0) ? SENTENCE_LUT[i - 1].head : 0;
+  if ((f == 0) || (FORMATTER_PACK(f[0], f[1], f[2]) != formatter)) {
+    STATS_ADD(n, unknown_sentences, 1);
+    return;
+  }
+  if ((n->state.sentences_subscribed &
+       (((nmea_sentence_bitmap_t)1) << (i - 1))) != 0) {
+    n->data.talker = talker_from_packed(n->state.scratch >> 24);
+    n->state.sentence = &SENTENCE_LUT[i - 1];
+#if defined(NMEA_LAZY_DECODE)
+    if (sentence_is_lazy(n->state.sentence) != 0) {
+      lazy_start(n);
     }
+#endif
     n->state.sentence->start_handler(n);
-  } else {
-    n->state.sentence = &IGNORE_SENTENCE;
   }
 }
 
+/* buffer parsing scans ahead for the chars that the state machine treats
+ * specially, a bit is set in the mask for each '$', ',', '*', '\r' or '\n' in a
+ * block, runs of other chars are passed to the field handlers as spans */
+#if defined(__AVX2__)
+static const size_t DELIMITER_BLOCK = 32;
+#elif defined(__SSE2__)
+static const size_t DELIMITER_BLOCK = 16;
+#else
+static const size_t DELIMITER_BLOCK = 32;
+#endif
+
+static char is_delimiter(const char c) {
+  return ((c == '$') || (c == ',') || (c == '*') || (c == '\r') ||
+          (c == '\n'))
+             ? 1
+             : 0;
+}
+
+static unsigned long int delimiter_mask(const char *const p, const size_t len) {
+  if (len >= DELIMITER_BLOCK) {
+#if defined(__AVX2__)
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    __m256i m = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('$')),
+                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))),
+        _mm256_or_si256(
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('*')),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')))));
+    return (unsigned long int)(unsigned int)_mm256_movemask_epi8(m);
+#elif defined(__SSE2__)
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i m = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('$')),
+                     _mm_cmpeq_epi8(v, _mm_set1_epi8(','))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('*')),
+                     _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')),
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')))));
+    return (unsigned long int)(unsigned int)_mm_movemask_epi8(m);
+#endif
+  }
+  /* scalar fallback, also handles the tail of the buffer */
+  unsigned long int mask = 0;
+  size_t i = (len < DELIMITER_BLOCK) ? len : DELIMITER_BLOCK;
+  while (i != 0) {
+    --i;
+    mask = (mask << 1) | is_delimiter(p[i]);
+  }
+  return mask;
+}
+
+static unsigned char mask_ctz(unsigned long int mask) {
+#if defined(__GNUC__)
+  return __builtin_ctzl(mask);
+#else
+  unsigned char i = 0;
+  while ((mask & 1) == 0) {
+    mask >>= 1;
+    ++i;
+  }
+  return i;
+#endif
+}
+
+struct delimiter_scan {
+  const char *buf;
+  size_t len;
+  size_t block; /* offset of the block described by mask */
+  unsigned long int mask;
+};
+
+/* returns the offset of the first delimiter at or after i, or len if there is
+ * none, reusing the mask of the last block scanned where possible */
+static size_t next_delimiter(struct delimiter_scan *const s, size_t i) {
+  while (i < s->len) {
+    if ((i < s->block) || (i >= (s->block + DELIMITER_BLOCK))) {
+      s->block = i;
+      s->mask = delimiter_mask(&s->buf[i], s->len - i);
+    }
+    unsigned long int m = s->mask >> (i - s->block);
+    if (m != 0) {
+      return i + mask_ctz(m);
+    }
+    i = s->block + DELIMITER_BLOCK;
+  }
+  return s->len;
+}
+
+/* equivalent to the non-delimiter path of parse_char for each char */
+static void field_span(struct nmea *const n, const char *const p,
+                       const size_t len) {
+  const enum nmea_fields field = n->state.field;
+  const unsigned char kind = n->state.field_kind;
+  n->state.field_bitmap |= ((nmea_field_bitmap_t)1) << field;
+  if (kind == FIELD_KIND_IGNORE) {
+    n->state.checksum ^= nmea_checksum(p, len);
+    return;
+  }
+#if defined(NMEA_LAZY_DECODE)
+  if (kind == FIELD_KIND_RECORD) {
+    n->state.checksum ^= nmea_checksum(p, len);
+    lazy_record(n, p, len);
+    return;
+  }
+#endif
+  unsigned char checksum = n->state.checksum;
+  size_t i = 0;
+#if defined(NMEA_SWITCH_DISPATCH)
+  /* most chars are in fixed point fields, give them their own loops */
+  if ((kind == FIELD_KIND_UFXP) || (kind == FIELD_KIND_FXP)) {
+    const unsigned char q = NMEA_FXP_FRACTIONALS[field];
+    while (i < len) {
+      if (kind == FIELD_KIND_UFXP) {
+        ufxp_from_ascii(&n->state.fxpse.fxp, p[i], q);
+      } else {
+        fxp_from_ascii(&n->state.fxpse.fxp, p[i], q);
+      }
+      checksum ^= p[i];
+      ++i;
+    }
+  }
+#endif
+  while (i < len) {
+    field_char(n, p[i]);
+    checksum ^= p[i];
+    ++i;
+  }
+  n->state.checksum = checksum;
+}
+
 static unsigned char hex_to_nibble(const char c) {
   return (c <= '9') ? c - '0' : (c - 'A') + 10;
 }
 
-void nmea_parse(struct nmea *const n, const char c) {
+/* returns 1 if the char completed a sentence that set new received flags */
+static inline char parse_char(struct nmea *const n, const char c) {
+  char ready = 0;
   if (c == '$') {
     /* reset */
     n->state.field_bitmap = 0;
+    n->state.field = NMEA_FIELD_HEADER;
+    n->state.field_kind = FIELD_KIND_HEADER;
     n->state.field_handlers = &HANDLER_LUT[NMEA_FIELD_HEADER];
     n->state.field_handlers->start_handler(n);
+    LATENCY_START(n);
   } else if (n->state.checksum_recording != 0) {
     if (n->state.char_count == 0) {
       n->state.fxpse.fxp.val = hex_to_nibble(c) << 4;
@@ -698,15 +1332,21 @@ void nmea_parse(struct nmea *const n, const char c) {
     } else {
       if ((n->state.fxpse.fxp.val | hex_to_nibble(c)) == n->state.checksum) {
         /* checksum pass */
+        STATS_CHECKSUM(n, 1);
+        const nmea_field_bitmap_t received = n->state.received;
         n->state.sentence->end_handler(n);
+        LATENCY_END(n);
+        ready = ((n->state.received & ~received) != 0) ? 1 : 0;
       } else {
         /* checksum fail */
+        STATS_CHECKSUM(n, 0);
         n->state.sentence->checksum_fail_handler(n);
       }
       n->state.checksum_recording = 0;
     }
   } else if (c == ',') {
     n->state.received &= ~(((nmea_field_bitmap_t)1) << n->state.field);
+    STATS_FIELD_END(n, n->state.field, n->state.field_kind);
     n->state.field_handlers->end_handler(n);
     field_update(n);
     ++n->state.comma_count;
@@ -714,15 +1354,87 @@ void nmea_parse(struct nmea *const n, const char c) {
     n->state.checksum ^= c;
   } else if (c == '*') {
     n->state.received &= ~(((nmea_field_bitmap_t)1) << n->state.field);
+    STATS_FIELD_END(n, n->state.field, n->state.field_kind);
     n->state.field_handlers->end_handler(n);
     n->state.checksum_recording = 1;
     n->state.char_count = 0;
   } else {
     /* call handler */
     n->state.field_bitmap |= ((nmea_field_bitmap_t)1) << n->state.field;
-    n->state.field_handlers->char_handler(n, c);
+    field_char(n, c);
     n->state.checksum ^= c;
   }
+  return ready;
+}
+
+void nmea_parse(struct nmea *const n, const char c) {
+  STATS_ADD(n, bytes, 1);
+  (void)parse_char(n, c);
+}
+
+size_t nmea_parse_buf(struct nmea *const n, const char *const buf,
+                      const size_t len) {
+  struct delimiter_scan scan = {buf, len, (size_t)-1, 0};
+  size_t i = 0;
+  while (i < len) {
+    if ((n->state.sentence == &IGNORE_SENTENCE) &&
+        (n->state.field_kind != FIELD_KIND_HEADER)) {
+      /* nothing up to the start of the next sentence is parsed */
+      const char *const start = memchr(&buf[i], '$', len - i);
+      if (start == 0) {
+        i = len;
+        break;
+      }
+      i = start - buf;
+    }
+    if (n->state.checksum_recording == 0) {
+      size_t next = next_delimiter(&scan, i);
+      if (next != i) {
+        field_span(n, &buf[i], next - i);
+        i = next;
+        continue;
+      }
+    }
+    char ready = parse_char(n, buf[i]);
+    ++i;
+    if (ready != 0) {
+      break;
+    }
+  }
+  STATS_ADD(n, bytes, i);
+  return i;
+}
+
+unsigned char nmea_checksum(const char *const buf, const size_t len) {
+  size_t i = 0;
+  unsigned long long int word = 0;
+#if defined(__SSE2__)
+  if (len >= 16) {
+    __m128i acc = _mm_setzero_si128();
+    while ((len - i) >= 16) {
+      acc = _mm_xor_si128(acc, _mm_loadu_si128((const __m128i *)&buf[i]));
+      i += 16;
+    }
+    acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 8));
+    _mm_storel_epi64((__m128i *)&word, acc);
+  }
+#endif
+  /* SWAR, xor 8 chars at a time then fold the word down to a byte */
+  while ((len - i) >= sizeof(word)) {
+    unsigned long long int w;
+    memcpy(&w, &buf[i], sizeof(w));
+    word ^= w;
+    i += sizeof(w);
+  }
+  word ^= word >> 32;
+  word ^= word >> 16;
+  word ^= word >> 8;
+  unsigned char checksum = word;
+  while (i < len) {
+    checksum ^= buf[i];
+    ++i;
+  }
+  return checksum;
 }
 
 char nmea_fields_ready(struct nmea *const n, const nmea_field_bitmap_t fields) {
@@ -733,9 +1445,344 @@ char nmea_fields_ready(struct nmea *const n, const nmea_field_bitmap_t fields) {
   return 0;
 }
 
+void nmea_decode(struct nmea *const n, const nmea_field_bitmap_t fields) {
+#if defined(NMEA_LAZY_DECODE)
+  /* the direction fields set the sign of the value before them */
+  static const nmea_field_bitmap_t pairs[] = {
+      NMEA_FIELD_LATITUDE_MASK | NMEA_FIELD_LATITUDE_DIR_MASK,
+      NMEA_FIELD_LONGITUDE_MASK | NMEA_FIELD_LONGITUDE_DIR_MASK,
+      NMEA_FIELD_MAGNETIC_VARIATION_MASK |
+          NMEA_FIELD_MAGNETIC_VARIATION_DIR_MASK};
+  nmea_field_bitmap_t decode = fields;
+  unsigned char i = 0;
+  while (i < (sizeof(pairs) / sizeof(pairs[0]))) {
+    if ((fields & pairs[i]) != 0) {
+      decode |= pairs[i];
+    }
+    ++i;
+  }
+  decode &= n->lazy.pending;
+  if (decode == 0) {
+    return;
+  }
+
+  /* the handlers use the parser state, which may be mid sentence */
+  const struct nmea_state state = n->state;
+  const enum nmea_fields *const sentence_fields = n->lazy.sentence->fields;
+  i = 0;
+  while (i < n->lazy.count) {
+    const enum nmea_fields field = sentence_fields[i];
+    if ((decode & (((nmea_field_bitmap_t)1) << field)) != 0) {
+      const struct nmea_field_handlers *const h = &HANDLER_LUT[field];
+      const char *const p = &n->lazy.buf[n->lazy.offsets[i]];
+      const unsigned char len = n->lazy.lengths[i];
+      unsigned char j = 0;
+      h->start_handler(n);
+      while (j < len) {
+        h->char_handler(n, p[j]);
+        ++j;
+      }
+      STATS_FIELD_END(n, field, FIELD_KIND_LUT[field]);
+      h->end_handler(n);
+    }
+    ++i;
+  }
+  const struct nmea_date_cache date_cache = n->state.date_cache;
+  n->state = state;
+  n->state.date_cache = date_cache;
+  n->lazy.pending &= ~decode;
+#else
+  (void)n;
+  (void)fields;
+#endif
+}
+
+void nmea_data_merge(struct nmea_data *const dst,
+                     const struct nmea_data *const src,
+                     const nmea_field_bitmap_t fields) {
+  if (fields == 0) {
+    return;
+  }
+  dst->talker = src->talker;
+  /* visit only the set bits */
+  nmea_field_bitmap_t remaining = fields;
+  while (remaining != 0) {
+    const unsigned char field = mask_ctz(remaining);
+    remaining &= remaining - 1;
+    switch (field) {
+    case NMEA_FIELD_LONGITUDE:
+    case NMEA_FIELD_LONGITUDE_DIR:
+      dst->longitude = src->longitude;
+      break;
+    case NMEA_FIELD_LATITUDE:
+    case NMEA_FIELD_LATITUDE_DIR:
+      dst->latitude = src->latitude;
+      break;
+    case NMEA_FIELD_FIX_QUALITY:
+      dst->fix_quality = src->fix_quality;
+      break;
+    case NMEA_FIELD_SATELLITES_TRACKED:
+      dst->satellites_tracked = src->satellites_tracked;
+      break;
+    case NMEA_FIELD_SATELLITES_IN_VIEW:
+      dst->satellites_in_view = src->satellites_in_view;
+      break;
+    case NMEA_FIELD_ALTITUDE:
+      dst->altitude = src->altitude;
+      break;
+    case NMEA_FIELD_GEOID_HEIGHT:
+      dst->geoid_height = src->geoid_height;
+      break;
+    case NMEA_FIELD_FIX_3D:
+      dst->fix_3d = src->fix_3d;
+      break;
+    case NMEA_FIELD_PRNS_TRACKED:
+      memcpy(dst->prns_tracked, src->prns_tracked, sizeof(dst->prns_tracked));
+      break;
+    case NMEA_FIELD_PRN:
+    case NMEA_FIELD_AZIMUTH:
+    case NMEA_FIELD_ELEVATION:
+    case NMEA_FIELD_SNR:
+      memcpy(dst->sats, src->sats, sizeof(dst->sats));
+      break;
+    case NMEA_FIELD_PDOP:
+      dst->pdop = src->pdop;
+      break;
+    case NMEA_FIELD_HDOP:
+      dst->hdop = src->hdop;
+      break;
+    case NMEA_FIELD_VDOP:
+      dst->vdop = src->vdop;
+      break;
+    case NMEA_FIELD_GLL_ACTIVE:
+      dst->gll_active = src->gll_active;
+      break;
+    case NMEA_FIELD_RMC_ACTIVE:
+      dst->rmc_active = src->rmc_active;
+      break;
+    case NMEA_FIELD_SPEED:
+      dst->speed = src->speed;
+      break;
+    case NMEA_FIELD_TIME:
+    case NMEA_FIELD_DATE:
+      dst->time = src->time;
+      break;
+    case NMEA_FIELD_MAGNETIC_VARIATION:
+    case NMEA_FIELD_MAGNETIC_VARIATION_DIR:
+      dst->magnetic_variation = src->magnetic_variation;
+      break;
+    case NMEA_FIELD_TRUE_TRACK:
+      dst->true_track = src->true_track;
+      break;
+    case NMEA_FIELD_MAGNETIC_TRACK:
+      dst->magnetic_track = src->magnetic_track;
+      break;
+    default:
+      break;
+    }
+  }
+}
+
 void nmea_init(struct nmea *const n) {
+  nmea_init_subscribed(n, ~(nmea_sentence_bitmap_t)0, ~(nmea_field_bitmap_t)0);
+}
+
+void nmea_init_subscribed(struct nmea *const n,
+                          const nmea_sentence_bitmap_t sentences,
+                          const nmea_field_bitmap_t fields) {
+  /* the fields that others depend on when they are parsed */
+  static const struct {
+    nmea_field_bitmap_t fields;
+    nmea_field_bitmap_t depends;
+  } deps[] = {
+      {NMEA_FIELD_LATITUDE_MASK, NMEA_FIELD_LATITUDE_DIR_MASK},
+      {NMEA_FIELD_LONGITUDE_MASK, NMEA_FIELD_LONGITUDE_DIR_MASK},
+      {NMEA_FIELD_MAGNETIC_VARIATION_MASK,
+       NMEA_FIELD_MAGNETIC_VARIATION_DIR_MASK},
+      /* the SNR end handler moves on to the next satellite */
+      {NMEA_FIELD_PRN_MASK | NMEA_FIELD_ELEVATION_MASK |
+           NMEA_FIELD_AZIMUTH_MASK,
+       NMEA_FIELD_SNR_MASK},
+      /* a GSV set is only complete once every sentence in it is received */
+      {~(nmea_field_bitmap_t)0,
+       NMEA_FIELD_GSV_SENTENCES_TOTAL_MASK | NMEA_FIELD_SENTENCE_NO_MASK}};
+
   memset(n, 0, sizeof(*n));
+  n->state.sentences_subscribed = sentences;
+  n->state.fields_subscribed = fields | NMEA_FIELD_IGNORE_MASK;
+  unsigned char i = 0;
+  while (i < (sizeof(deps) / sizeof(deps[0]))) {
+    if ((fields & deps[i].fields) != 0) {
+      n->state.fields_subscribed |= deps[i].depends;
+    }
+    ++i;
+  }
+  nmea_set_century(n, NMEA_CENTURY);
   n->state.sentence = &IGNORE_SENTENCE;
   n->state.field = NMEA_FIELD_IGNORE;
+  n->state.field_kind = FIELD_KIND_IGNORE;
   n->state.field_handlers = &HANDLER_LUT[NMEA_FIELD_IGNORE];
 }
+
+void nmea_set_callbacks(struct nmea *const n,
+                        const struct nmea_callback *const callbacks,
+                        const size_t count) {
+  n->state.callbacks = callbacks;
+  n->state.callback_count = (callbacks == 0) ? 0 : count;
+}
+
+void nmea_set_century(struct nmea *const n, const unsigned long int century) {
+  n->state.date_cache.century = century;
+  n->state.date_cache.ddmmyy = (unsigned long int)-1;
+}
+
+#if defined(NMEA_STATS)
+void nmea_stats_get(const struct nmea *const n,
+                    struct nmea_stats *const stats) {
+  *stats = n->stats;
+}
+
+/* appends a line to the text like snprintf, counting the full length of the
+ * text in pos even once buf is full */
+static void stats_line(char *const buf, const size_t len, size_t *const pos,
+                       const char *const a, const char *const b,
+                       const char *const c, const char *const d) {
+  const size_t at = (*pos < len) ? *pos : len;
+  const int l = snprintf(&buf[at], len - at, "%s%s%s%s\n", a, b, c, d);
+  *pos += (l > 0) ? (size_t)l : 0;
+}
+
+/* appends a sample, labels longer than the label buffer are truncated */
+static void stats_sample(char *const buf, const size_t len, size_t *const pos,
+                         const char *const name, const char *const sentence,
+                         const char *const labels,
+                         const unsigned long long int value) {
+  char set[256];
+  set[0] = '\0';
+  if (sentence != 0) {
+    snprintf(set, sizeof(set), "{sentence=\"%s\"%s%s}", sentence,
+             (labels != 0) ? "," : "", (labels != 0) ? labels : "");
+  } else if (labels != 0) {
+    snprintf(set, sizeof(set), "{%s}", labels);
+  }
+  char v[32];
+  snprintf(v, sizeof(v), " %llu", value);
+  stats_line(buf, len, pos, name, set, v, "");
+}
+
+int nmea_stats_prometheus(const struct nmea_stats *const stats,
+                          const char *const labels, char *const buf,
+                          const size_t len) {
+  static const struct {
+    const char *name;
+    const char *help;
+    size_t offset;
+  } counters[] = {
+      {"nmea_checksum_passes_total",
+       "Supported sentences with a valid checksum.",
+       offsetof(struct nmea_stats, checksum_passes)},
+      {"nmea_checksum_failures_total",
+       "Supported sentences with an invalid checksum.",
+       offsetof(struct nmea_stats, checksum_failures)},
+      {"nmea_unknown_sentences_total", "Sentences with an unsupported header.",
+       offsetof(struct nmea_stats, unknown_sentences)},
+      {"nmea_saturations_total", "Fixed point fields too large to hold.",
+       offsetof(struct nmea_stats, saturations)},
+      {"nmea_gsv_sets_abandoned_total",
+       "GSV sets dropped before all of their sentences arrived.",
+       offsetof(struct nmea_stats, gsv_sets_abandoned)},
+      {"nmea_bytes_total", "Chars parsed.",
+       offsetof(struct nmea_stats, bytes)}};
+
+  size_t pos = 0;
+  stats_line(buf, len, &pos, "# HELP nmea_sentences_total",
+             " Sentences that passed their checksum, by type.", "", "");
+  stats_line(buf, len, &pos, "# TYPE nmea_sentences_total counter", "", "",
+             "");
+  size_t i = 0;
+  while (i < NMEA_SENTENCE_COUNT) {
+    stats_sample(buf, len, &pos, "nmea_sentences_total", SENTENCE_LUT[i].head,
+                 labels, stats->sentences[i]);
+    ++i;
+  }
+  i = 0;
+  while (i < (sizeof(counters) / sizeof(counters[0]))) {
+    unsigned long long int value;
+    memcpy(&value, (const char *)stats + counters[i].offset, sizeof(value));
+    stats_line(buf, len, &pos, "# HELP ", counters[i].name, " ",
+               counters[i].help);
+    stats_line(buf, len, &pos, "# TYPE ", counters[i].name, " counter", "");
+    stats_sample(buf, len, &pos, counters[i].name, 0, labels, value);
+    ++i;
+  }
+  return (pos > INT_MAX) ? INT_MAX : (int)pos;
+}
+#endif
+
+#if defined(NMEA_LATENCY)
+/* the bucket of a latency, see NMEA_LATENCY_BUCKETS */
+static unsigned int latency_bucket(const unsigned long long int ns) {
+  const unsigned long long int sub = 1ull << NMEA_LATENCY_SUB_BITS;
+  if (ns < sub) {
+    return ns;
+  }
+  if ((ns >> 36) != 0) {
+    return NMEA_LATENCY_BUCKETS - 1;
+  }
+#if defined(__GNUC__)
+  const unsigned int msb = 63 - __builtin_clzll(ns);
+#else
+  unsigned int msb = 0;
+  while ((ns >> (msb + 1)) != 0) {
+    ++msb;
+  }
+#endif
+  const unsigned int shift = msb - NMEA_LATENCY_SUB_BITS;
+  return ((shift + 1) << NMEA_LATENCY_SUB_BITS) + ((ns >> shift) & (sub - 1));
+}
+
+/* the largest latency in a bucket */
+static unsigned long long int latency_bucket_max(const unsigned int bucket) {
+  const unsigned int sub = 1u << NMEA_LATENCY_SUB_BITS;
+  if (bucket < sub) {
+    return bucket;
+  }
+  const unsigned int shift = (bucket >> NMEA_LATENCY_SUB_BITS) - 1;
+  return ((((unsigned long long int)(sub + (bucket & (sub - 1)))) + 1)
+          << shift) -
+         1;
+}
+
+void nmea_latency_record(struct nmea_latency_histogram *const h,
+                         const unsigned long long int ns) {
+  ++h->counts[latency_bucket(ns)];
+  ++h->total;
+  if (ns > h->max) {
+    h->max = ns;
+  }
+}
+
+unsigned long long int
+nmea_latency_quantile(const struct nmea_latency_histogram *const h,
+                      const double q) {
+  if (h->total == 0) {
+    return 0;
+  }
+  /* the rank of the sample, from 1 */
+  unsigned long long int rank = (unsigned long long int)(q * h->total);
+  if (((double)rank < (q * h->total)) || (rank == 0)) {
+    ++rank;
+  }
+  unsigned long long int count = 0;
+  unsigned int i = 0;
+  while (i < (NMEA_LATENCY_BUCKETS - 1)) {
+    count += h->counts[i];
+    if (count >= rank) {
+      break;
+    }
+    ++i;
+  }
+  const unsigned long long int max = latency_bucket_max(i);
+  return (max < h->max) ? max : h->max;
+}
+#endif
@@ -21,11 +21,14 @@
 
 #define NMEA_MAX_SATS (20)
 #define NMEA_MAX_PRNS_TRACKED (12)
+/* only used with NMEA_LAZY_DECODE */
+#define NMEA_LAZY_MAX_CHARS (82)
+#define NMEA_LAZY_MAX_FIELDS (20)
 
 static const unsigned long int NMEA_CENTURY = 2000;
 static const unsigned long int NMEA_CENTURY_OFFSET = 946684800ul;
 
-typedef unsigned short int nmea_sentence_bitmap_t;
+typedef unsigned long int nmea_sentence_bitmap_t;
 typedef unsigned long int nmea_field_bitmap_t;
 /* can accommodate 8 GSV messages */
 typedef unsigned char nmea_gsv_bitmap_t;
@@ -71,6 +74,26 @@ enum nmea_fields {
   NMEA_FIELD_HEADER
 };
 
+enum nmea_sentences {
+  NMEA_SENTENCE_GGA = 0,
+  NMEA_SENTENCE_GLL,
+  NMEA_SENTENCE_GSA,
+  NMEA_SENTENCE_GSV,
+  NMEA_SENTENCE_RMC,
+  NMEA_SENTENCE_VTG
+};
+
+enum nmea_talker {
+  NMEA_TALKER_OTHER = 0,
+  NMEA_TALKER_GP, /* GPS */
+  NMEA_TALKER_GL, /* GLONASS */
+  NMEA_TALKER_GA, /* Galileo */
+  NMEA_TALKER_GB, /* BeiDou */
+  NMEA_TALKER_BD, /* BeiDou */
+  NMEA_TALKER_GQ, /* QZSS */
+  NMEA_TALKER_GN  /* combined GNSS */
+};
+
 static const nmea_field_bitmap_t NMEA_FB1 = 1;
 static const nmea_field_bitmap_t NMEA_FIELD_LONGITUDE_MASK =
     NMEA_FB1 << NMEA_FIELD_LONGITUDE;
@@ -140,6 +163,20 @@ static const nmea_field_bitmap_t NMEA_FIELD_TRUE_TRACK_MASK =
 static const nmea_field_bitmap_t NMEA_FIELD_MAGNETIC_TRACK_MASK =
     NMEA_FB1 << NMEA_FIELD_MAGNETIC_TRACK;
 
+static const nmea_sentence_bitmap_t NMEA_SB1 = 1;
+static const nmea_sentence_bitmap_t NMEA_SENTENCE_GGA_MASK =
+    NMEA_SB1 << NMEA_SENTENCE_GGA;
+static const nmea_sentence_bitmap_t NMEA_SENTENCE_GLL_MASK =
+    NMEA_SB1 << NMEA_SENTENCE_GLL;
+static const nmea_sentence_bitmap_t NMEA_SENTENCE_GSA_MASK =
+    NMEA_SB1 << NMEA_SENTENCE_GSA;
+static const nmea_sentence_bitmap_t NMEA_SENTENCE_GSV_MASK =
+    NMEA_SB1 << NMEA_SENTENCE_GSV;
+static const nmea_sentence_bitmap_t NMEA_SENTENCE_RMC_MASK =
+    NMEA_SB1 << NMEA_SENTENCE_RMC;
+static const nmea_sentence_bitmap_t NMEA_SENTENCE_VTG_MASK =
+    NMEA_SB1 << NMEA_SENTENCE_VTG;
+
 /* Specifies how many fractional bits to use for the fixed point values of each
  * specific field, 0 indicates an integer */
 static const unsigned char NMEA_FXP_FRACTIONALS[] = {
@@ -180,7 +217,12 @@ struct nmea_sat {
 
 struct nmea_fxp_state {
   unsigned long long int val;
+#if defined(NMEA_FXP_DEFERRED)
+  unsigned long long int frac;
+  unsigned char frac_digits;
+#else
   unsigned long long int div;
+#endif
   unsigned int dp : 1;
   unsigned int neg : 1;
 };
@@ -207,22 +249,55 @@ struct nmea_sentence_format {
   void (*start_handler)(struct nmea *const n);
   void (*end_handler)(struct nmea *const n);
   void (*checksum_fail_handler)(struct nmea *const n);
-  const char head[6];
+  const char head[4]; /* sentence formatter, matched with any talker ID */
   unsigned char length;
 };
 
+/* the days since the epoch of the last date parsed, in DDMMYY */
+struct nmea_date_cache {
+  unsigned long int century;
+  unsigned long int ddmmyy;
+  long int days;
+};
+
+struct nmea_data;
+
+/*
+ * Called when a sentence passes its checksum, with the fields that it set. A
+ * set of GSV sentences calls back once, when its last sentence is received.
+ */
+typedef void (*nmea_callback_fn)(const struct nmea_data *const data,
+                                 const enum nmea_sentences sentence,
+                                 const nmea_field_bitmap_t fields,
+                                 void *const ctx);
+
+/* a callback that is only called for the sentences in its sentences mask that
+ * set any of the fields in its fields mask */
+struct nmea_callback {
+  nmea_callback_fn fn;
+  nmea_sentence_bitmap_t sentences;
+  nmea_field_bitmap_t fields;
+  void *ctx;
+};
+
 struct nmea_state {
   union nmea_fxpse fxpse;
   unsigned long long int scratch;
   const struct nmea_field_handlers *field_handlers;
   const struct nmea_sentence_format *sentence;
   nmea_field_bitmap_t received;
+  nmea_sentence_bitmap_t sentences_subscribed;
+  nmea_field_bitmap_t fields_subscribed;
   enum nmea_fields field;
+  unsigned char field_kind;
   unsigned int checksum_recording : 1;
-  nmea_sentence_bitmap_t sentence_bitmap;
   nmea_field_bitmap_t field_bitmap;
   nmea_gsv_bitmap_t gsv_sentences_received;
   unsigned short int gsv_satellite_count;
+  enum nmea_talker gsv_talker;
+  struct nmea_date_cache date_cache;
+  const struct nmea_callback *callbacks;
+  size_t callback_count;
   unsigned char gsv_satellite_index;
   unsigned char gsv_sentence_no;
   unsigned char gsv_sentences_total;
@@ -251,15 +326,85 @@ struct nmea_data {
   enum nmea_fix_3d fix_3d;
   enum nmea_active gll_active;
   enum nmea_active rmc_active;
+  /* talker ID of the last sentence parsed */
+  enum nmea_talker talker;
   struct nmea_sat sats[NMEA_MAX_SATS];
   unsigned char prns_tracked[NMEA_MAX_PRNS_TRACKED];
   unsigned short int satellites_tracked;
   unsigned short int satellites_in_view;
 };
 
+/* the fields of the last lazily parsed sentence, waiting to be decoded */
+struct nmea_lazy {
+  const struct nmea_sentence_format *sentence;
+  nmea_field_bitmap_t pending;
+  unsigned char offsets[NMEA_LAZY_MAX_FIELDS];
+  unsigned char lengths[NMEA_LAZY_MAX_FIELDS];
+  char buf[NMEA_LAZY_MAX_CHARS];
+  unsigned char len;
+  unsigned char count;
+};
+
+/* one more than the last of enum nmea_sentences */
+#define NMEA_SENTENCE_COUNT (NMEA_SENTENCE_VTG + 1)
+
+#if defined(NMEA_STATS)
+/* counts of what the parser has seen since it was initialised */
+struct nmea_stats {
+  /* sentences that passed their checksum, indexed by enum nmea_sentences */
+  unsigned long long int sentences[NMEA_SENTENCE_COUNT];
+  /* the checksums of supported sentences, unsupported and unsubscribed
+   * sentences are skipped without checking theirs */
+  unsigned long long int checksum_passes;
+  unsigned long long int checksum_failures;
+  /* sentences with a header that isn't a supported sentence */
+  unsigned long long int unknown_sentences;
+  /* fixed point fields too large to hold, set to their largest value */
+  unsigned long long int saturations;
+  /* sets of GSV sentences dropped before all of their sentences arrived */
+  unsigned long long int gsv_sets_abandoned;
+  /* chars passed to nmea_parse and consumed by nmea_parse_buf */
+  unsigned long long int bytes;
+};
+#endif
+
+#if defined(NMEA_LATENCY)
+/* values below 2^NMEA_LATENCY_SUB_BITS have a bucket each, above that each
+ * power of 2 is split into 2^NMEA_LATENCY_SUB_BITS buckets, so a bucket is
+ * within 1/16 of its values. Values of 2^36 ns, about 69 s, or more share the
+ * last bucket. */
+#define NMEA_LATENCY_SUB_BITS (4)
+#define NMEA_LATENCY_BUCKETS                                                   \
+  ((36 - NMEA_LATENCY_SUB_BITS + 1) << NMEA_LATENCY_SUB_BITS)
+
+/* a log bucketed histogram of latencies in nanoseconds */
+struct nmea_latency_histogram {
+  unsigned long int counts[NMEA_LATENCY_BUCKETS];
+  unsigned long long int total;
+  unsigned long long int max;
+};
+
+/* the time from the '$' of each sentence until its checksum passes, when its
+ * fields are usable */
+struct nmea_latency {
+  struct nmea_latency_histogram sentences[NMEA_SENTENCE_COUNT];
+  /* the monotonic time of the last '$' */
+  unsigned long long int start;
+};
+#endif
+
 struct nmea {
   struct nmea_state state;
   struct nmea_data data;
+#if defined(NMEA_LAZY_DECODE)
+  struct nmea_lazy lazy;
+#endif
+#if defined(NMEA_STATS)
+  struct nmea_stats stats;
+#endif
+#if defined(NMEA_LATENCY)
+  struct nmea_latency latency;
+#endif
 };
 
 /*
@@ -267,6 +412,24 @@ struct nmea {
  */
 void nmea_parse(struct nmea *const n, const char c);
 
+/*
+ * Equivalent to passing each of the len chars in buf to nmea_parse in turn, but
+ * returns early, immediately after any char that completes a sentence and sets
+ * new flags in the received field bitmap. This means nmea_fields_ready only
+ * needs to be checked once per call rather than once per char.
+ *
+ * Returns the number of chars consumed, call again with the remainder of the
+ * buffer to continue parsing.
+ */
+size_t nmea_parse_buf(struct nmea *const n, const char *const buf,
+                      const size_t len);
+
+/*
+ * Returns the XOR of the len chars in buf, which for the chars between the '$'
+ * and the '*' of a sentence is its checksum.
+ */
+unsigned char nmea_checksum(const char *const buf, const size_t len);
+
 /*
  * If this function returns 1, the fields passed in through the fields argument
  * are considered valid to be read from the data struct until the next call to
@@ -279,9 +442,109 @@ void nmea_parse(struct nmea *const n, const char c);
  */
 char nmea_fields_ready(struct nmea *const n, const nmea_field_bitmap_t fields);
 
+/*
+ * With NMEA_LAZY_DECODE defined, the fields of GGA, GLL, RMC and VTG sentences
+ * are only recorded while parsing and are not converted until this is called.
+ * It decodes those of the fields passed in through the fields argument that
+ * were received in the last such sentence into the data struct, along with the
+ * direction fields that they depend on. Call it once nmea_fields_ready has
+ * returned 1, fields that are still not decoded when the next GGA, GLL, RMC or
+ * VTG sentence starts are dropped and no longer flagged as received.
+ *
+ * GSA and GSV sentences are always decoded as they are parsed. Without
+ * NMEA_LAZY_DECODE every sentence is, and this does nothing.
+ */
+void nmea_decode(struct nmea *const n, const nmea_field_bitmap_t fields);
+
+/*
+ * Registers count callbacks to be called as sentences complete, replacing any
+ * registered before. The callbacks array is owned by the caller and must stay
+ * valid until it is replaced, pass 0 and 0 to remove them. With
+ * NMEA_LAZY_DECODE the fields are decoded before the callbacks are called.
+ * Callbacks don't consume the fields, which can still be polled with
+ * nmea_fields_ready.
+ *
+ * for example:
+ *   static const struct nmea_callback callbacks[] = {
+ *       {&on_position, NMEA_SENTENCE_GGA_MASK | NMEA_SENTENCE_RMC_MASK,
+ *        NMEA_FIELD_LATITUDE_MASK | NMEA_FIELD_LONGITUDE_MASK, 0}};
+ *   nmea_set_callbacks(&n, callbacks, 1);
+ */
+void nmea_set_callbacks(struct nmea *const n,
+                        const struct nmea_callback *const callbacks,
+                        const size_t count);
+
+/*
+ * Copies the members of src that hold the fields passed in through the fields
+ * argument into dst, along with the talker ID if any fields are passed. Used to
+ * apply the fields set by a sentence parsed by one parser to the data of
+ * another.
+ */
+void nmea_data_merge(struct nmea_data *const dst,
+                     const struct nmea_data *const src,
+                     const nmea_field_bitmap_t fields);
+
 /*
  * Called once on startup, also resets the parser if required.
  */
 void nmea_init(struct nmea *const n);
 
+/*
+ * As nmea_init, but only parses the sentences and fields passed in through the
+ * sentences and fields arguments, as masks of the NMEA_SENTENCE_*_MASK and
+ * NMEA_FIELD_*_MASK constants. Other sentences are skipped without being
+ * parsed and other fields are neither converted nor flagged as received. The
+ * fields that a subscribed field depends on, such as the direction of latitude
+ * and longitude, and the fields that order GSV sentences, are always parsed.
+ *
+ * for example:
+ *   nmea_init_subscribed(&n, NMEA_SENTENCE_RMC_MASK,
+ *                        NMEA_FIELD_TIME_MASK | NMEA_FIELD_DATE_MASK);
+ */
+void nmea_init_subscribed(struct nmea *const n,
+                          const nmea_sentence_bitmap_t sentences,
+                          const nmea_field_bitmap_t fields);
+
+/*
+ * Sets the century that the 2 digit years of dates are in, for example 2000.
+ * nmea_init sets it to NMEA_CENTURY.
+ */
+void nmea_set_century(struct nmea *const n, const unsigned long int century);
+
+#if defined(NMEA_STATS)
+/*
+ * Copies the parser's statistics into stats. The parser updates them without
+ * synchronisation, so call this from the thread that parses.
+ */
+void nmea_stats_get(const struct nmea *const n, struct nmea_stats *const stats);
+
+/*
+ * Writes stats to buf in the Prometheus text format, adding labels to every
+ * sample if it is not 0, for example "port=\"ttyS0\"". Returns the length of
+ * the text, like snprintf, which is len or more if it was truncated.
+ */
+int nmea_stats_prometheus(const struct nmea_stats *const stats,
+                          const char *const labels, char *const buf,
+                          const size_t len);
+#endif
+
+#if defined(NMEA_LATENCY)
+/*
+ * Adds a latency of ns nanoseconds to the histogram. The parser records its own
+ * latencies in n->latency, this is for recording others to compare with them,
+ * such as the time from a read returning to the parser being called.
+ */
+void nmea_latency_record(struct nmea_latency_histogram *const h,
+                         const unsigned long long int ns);
+
+/*
+ * Returns the latency that the fraction q of the samples in the histogram are
+ * at or below, for example 0.999 for the 99.9th percentile, to within 1/16 of
+ * the value. Returns 0 if the histogram is empty.
+ */
+unsigned long long int
+nmea_latency_quantile(const struct nmea_latency_histogram *const h,
+                      const double q);
+#endif
+
 #endif
@@ -0,0 +1,431 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nmea_encode.h"
+
+#include <limits.h>
+
+/* the decimal places written for each fixed point field, latitude and
+ * longitude are of minutes */
+static const unsigned char ENCODE_DECIMALS[] = {
+    [NMEA_FIELD_LONGITUDE] = 6,    [NMEA_FIELD_LATITUDE] = 6,
+    [NMEA_FIELD_ALTITUDE] = 2,     [NMEA_FIELD_GEOID_HEIGHT] = 2,
+    [NMEA_FIELD_PDOP] = 3,         [NMEA_FIELD_HDOP] = 3,
+    [NMEA_FIELD_VDOP] = 3,         [NMEA_FIELD_SPEED] = 3,
+    [NMEA_FIELD_MAGNETIC_VARIATION] = 3,
+    [NMEA_FIELD_TRUE_TRACK] = 3,   [NMEA_FIELD_MAGNETIC_TRACK] = 3};
+
+static const unsigned long long int POW10[] = {1,    10,    100,    1000,
+                                               10000, 100000, 1000000};
+
+static const char TALKERS[][3] = {
+    [NMEA_TALKER_OTHER] = "GP", [NMEA_TALKER_GP] = "GP",
+    [NMEA_TALKER_GL] = "GL",    [NMEA_TALKER_GA] = "GA",
+    [NMEA_TALKER_GB] = "GB",    [NMEA_TALKER_BD] = "BD",
+    [NMEA_TALKER_GQ] = "GQ",    [NMEA_TALKER_GN] = "GN"};
+
+static const char HEX[] = "0123456789ABCDEF";
+
+static const long long int SECONDS_IN_DAY = 86400;
+
+/* writes chars to a buffer, counting those that don't fit so that the
+ * sentence can be rejected at the end rather than checked field by field */
+struct encoder {
+  char *buf;
+  size_t len;
+  size_t at;
+  unsigned char checksum;
+};
+
+static void put(struct encoder *const e, const char c) {
+  if (e->at < e->len) {
+    e->buf[e->at] = c;
+  }
+  ++e->at;
+  e->checksum ^= c;
+}
+
+static void put_str(struct encoder *const e, const char *s) {
+  while (*s != '\0') {
+    put(e, *s);
+    ++s;
+  }
+}
+
+/* writes v in decimal, padded with zeros to at least width digits */
+static void put_uint(struct encoder *const e, unsigned long long int v,
+                     const unsigned char width) {
+  char digits[20];
+  unsigned char count = 0;
+  while ((count == 0) || (v != 0) || (count < width)) {
+    digits[count] = (char)('0' + (v % 10));
+    v /= 10;
+    ++count;
+  }
+  while (count > 0) {
+    --count;
+    put(e, digits[count]);
+  }
+}
+
+/* writes the first decimals digits of a fraction of q bits, q must be at most
+ * 60 so that the fraction can be multiplied by 10 */
+static void put_frac(struct encoder *const e, unsigned long long int frac,
+                     const unsigned char q, unsigned char decimals) {
+  if (decimals == 0) {
+    return;
+  }
+  const unsigned long long int mask = (((unsigned long long int)1) << q) - 1;
+  put(e, '.');
+  while (decimals > 0) {
+    frac *= 10;
+    put(e, (char)('0' + (frac >> q)));
+    frac &= mask;
+    --decimals;
+  }
+}
+
+/* val of q bits plus half of the last decimal place written, so that the
+ * truncated digits are rounded to nearest */
+static unsigned long long int round_digit(const unsigned long long int val,
+                                          const unsigned char q,
+                                          const unsigned char decimals) {
+  const unsigned long long int half =
+      (((unsigned long long int)1) << q) / (2 * POW10[decimals]);
+  return (val > (ULLONG_MAX - half)) ? ULLONG_MAX : (val + half);
+}
+
+/* 1 if a rounded value of q bits is written as all zeros, so that its sign
+ * isn't written, as the parser would read it back as positive */
+static int rounds_to_zero(const unsigned long long int v,
+                          const unsigned char q,
+                          const unsigned char decimals) {
+  const unsigned long long int mask = (((unsigned long long int)1) << q) - 1;
+  /* the first digit is zero while the fraction times 10^decimals is less than
+   * 1, without the multiply that could overflow */
+  const unsigned long long int unit =
+      ((((unsigned long long int)1) << q) + POW10[decimals] - 1) /
+      POW10[decimals];
+  return ((v >> q) == 0) && ((v & mask) < unit);
+}
+
+static void put_rounded(struct encoder *const e,
+                        const unsigned long long int v, const unsigned char q,
+                        const unsigned char decimals) {
+  put_uint(e, v >> q, 1);
+  put_frac(e, v & ((((unsigned long long int)1) << q) - 1), q, decimals);
+}
+
+static void put_ufxp(struct encoder *const e, const unsigned long long int val,
+                     const enum nmea_fields field) {
+  const unsigned char q = NMEA_FXP_FRACTIONALS[field];
+  const unsigned char decimals = ENCODE_DECIMALS[field];
+  put_rounded(e, round_digit(val, q, decimals), q, decimals);
+}
+
+/* the magnitude of val, which doesn't overflow for LLONG_MIN */
+static unsigned long long int magnitude(const long long int val) {
+  return (val < 0) ? (0ull - (unsigned long long int)val)
+                   : (unsigned long long int)val;
+}
+
+/* writes a signed value followed by a comma and its direction, pos if it is
+ * positive and neg if it is negative, or with a minus sign if pos is 0 */
+static void put_fxp_dir(struct encoder *const e, const long long int val,
+                        const enum nmea_fields field, const char pos,
+                        const char neg) {
+  const unsigned char q = NMEA_FXP_FRACTIONALS[field];
+  const unsigned char decimals = ENCODE_DECIMALS[field];
+  const unsigned long long int v = round_digit(magnitude(val), q, decimals);
+  const int negative = (val < 0) && (rounds_to_zero(v, q, decimals) == 0);
+  if ((pos == '\0') && (negative != 0)) {
+    put(e, '-');
+  }
+  put_rounded(e, v, q, decimals);
+  if (pos != '\0') {
+    put(e, ',');
+    put(e, (negative != 0) ? neg : pos);
+  }
+}
+
+static void put_fxp(struct encoder *const e, const long long int val,
+                    const enum nmea_fields field) {
+  put_fxp_dir(e, val, field, '\0', '\0');
+}
+
+/* writes an angle in degrees as degrees and minutes followed by its direction,
+ * pos if it is positive and neg if it is negative */
+static void put_angle(struct encoder *const e, const long long int val,
+                      const enum nmea_fields field,
+                      const unsigned char degree_digits, const char pos,
+                      const char neg) {
+  const unsigned char q = NMEA_FXP_FRACTIONALS[field];
+  const unsigned char decimals = ENCODE_DECIMALS[field];
+  const unsigned long long int mask = (((unsigned long long int)1) << q) - 1;
+  const unsigned long long int a = magnitude(val);
+  unsigned long long int degrees = a >> q;
+  /* minutes in q bits, less than 61 << q so fits for q up to 57 */
+  unsigned long long int minutes = round_digit((a & mask) * 60, q, decimals);
+  if ((minutes >> q) >= 60) {
+    /* rounded up to the next degree */
+    ++degrees;
+    minutes -= ((unsigned long long int)60) << q;
+  }
+  put_uint(e, degrees, degree_digits);
+  put_uint(e, minutes >> q, 2);
+  put_frac(e, minutes & mask, q, decimals);
+  put(e, ',');
+  put(e, ((val < 0) && ((degrees != 0) ||
+                        (rounds_to_zero(minutes, q, decimals) == 0)))
+             ? neg
+             : pos);
+}
+
+/* the time of day of a time in seconds since the epoch, rounded down to the
+ * day before it for times before the epoch */
+static long long int time_of_day(const long long int time) {
+  const long long int tod = time % SECONDS_IN_DAY;
+  return (tod < 0) ? (tod + SECONDS_IN_DAY) : tod;
+}
+
+static void put_time(struct encoder *const e, const long long int time) {
+  const long long int tod = time_of_day(time);
+  put_uint(e, tod / 3600, 2);
+  put_uint(e, (tod / 60) % 60, 2);
+  put_uint(e, tod % 60, 2);
+  put_str(e, ".00");
+}
+
+/* writes the date of a time in seconds since the epoch as DDMMYY, the inverse
+ * of the days from civil conversion in the parser */
+static void put_date(struct encoder *const e, const long long int time) {
+  const long long int days = (time - time_of_day(time)) / SECONDS_IN_DAY;
+  /* days since 0000-03-01, in 400 year eras of 146097 days */
+  const long long int z = days + 719468;
+  const long long int era = ((z >= 0) ? z : (z - 146096)) / 146097;
+  const unsigned long int doe = (unsigned long int)(z - (era * 146097));
+  const unsigned long int yoe =
+      (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365;
+  const long long int year = (long long int)yoe + (era * 400);
+  const unsigned long int doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));
+  /* months from March */
+  const unsigned long int mp = ((5 * doy) + 2) / 153;
+  const unsigned long int day = doy - (((153 * mp) + 2) / 5) + 1;
+  const unsigned long int month = (mp < 10) ? (mp + 3) : (mp - 9);
+  const long long int y = (month <= 2) ? (year + 1) : year;
+  const long long int yy = y % 100;
+  put_uint(e, day, 2);
+  put_uint(e, month, 2);
+  put_uint(e, (yy < 0) ? (yy + 100) : yy, 2);
+}
+
+static void start_sentence(struct encoder *const e,
+                           const struct nmea_data *const data,
+                           const char *const formatter) {
+  put(e, '$');
+  e->checksum = 0;
+  const enum nmea_talker talker = data->talker;
+  put_str(e, ((unsigned int)talker < (sizeof(TALKERS) / sizeof(TALKERS[0])))
+                 ? TALKERS[talker]
+                 : TALKERS[NMEA_TALKER_OTHER]);
+  put_str(e, formatter);
+}
+
+static void end_sentence(struct encoder *const e) {
+  const unsigned char checksum = e->checksum;
+  put(e, '*');
+  put(e, HEX[checksum >> 4]);
+  put(e, HEX[checksum & 0xf]);
+  put(e, '\r');
+  put(e, '\n');
+}
+
+static char active(const enum nmea_active a) {
+  return (a == NMEA_ACTIVE) ? 'A' : 'V';
+}
+
+static void encode_gga(struct encoder *const e,
+                       const struct nmea_data *const data) {
+  start_sentence(e, data, "GGA,");
+  put_time(e, data->time);
+  put(e, ',');
+  put_angle(e, data->latitude, NMEA_FIELD_LATITUDE, 2, 'N', 'S');
+  put(e, ',');
+  put_angle(e, data->longitude, NMEA_FIELD_LONGITUDE, 3, 'E', 'W');
+  put(e, ',');
+  put_uint(e, data->fix_quality, 1);
+  put(e, ',');
+  put_uint(e, data->satellites_tracked, 2);
+  put(e, ',');
+  put_ufxp(e, data->hdop, NMEA_FIELD_HDOP);
+  put(e, ',');
+  put_fxp(e, data->altitude, NMEA_FIELD_ALTITUDE);
+  put_str(e, ",M,");
+  put_fxp(e, data->geoid_height, NMEA_FIELD_GEOID_HEIGHT);
+  put_str(e, ",M,,");
+  end_sentence(e);
+}
+
+static void encode_gll(struct encoder *const e,
+                       const struct nmea_data *const data) {
+  start_sentence(e, data, "GLL,");
+  put_angle(e, data->latitude, NMEA_FIELD_LATITUDE, 2, 'N', 'S');
+  put(e, ',');
+  put_angle(e, data->longitude, NMEA_FIELD_LONGITUDE, 3, 'E', 'W');
+  put(e, ',');
+  put_time(e, data->time);
+  put(e, ',');
+  put(e, active(data->gll_active));
+  /* the mode indicator */
+  put_str(e, (data->gll_active == NMEA_ACTIVE) ? ",A" : ",N");
+  end_sentence(e);
+}
+
+static void encode_gsa(struct encoder *const e,
+                       const struct nmea_data *const data) {
+  start_sentence(e, data, "GSA,A,");
+  put_uint(e, data->fix_3d, 1);
+  unsigned int i = 0;
+  while (i < NMEA_MAX_PRNS_TRACKED) {
+    put(e, ',');
+    /* a prn of 0 is an empty slot */
+    if (data->prns_tracked[i] != 0) {
+      put_uint(e, data->prns_tracked[i], 2);
+    }
+    ++i;
+  }
+  put(e, ',');
+  put_ufxp(e, data->pdop, NMEA_FIELD_PDOP);
+  put(e, ',');
+  put_ufxp(e, data->hdop, NMEA_FIELD_HDOP);
+  put(e, ',');
+  put_ufxp(e, data->vdop, NMEA_FIELD_VDOP);
+  end_sentence(e);
+}
+
+static void encode_gsv(struct encoder *const e,
+                       const struct nmea_data *const data) {
+  const unsigned int sats = (data->satellites_in_view < NMEA_MAX_SATS)
+                                ? data->satellites_in_view
+                                : NMEA_MAX_SATS;
+  /* a set with no satellites is a single sentence */
+  const unsigned int total = (sats == 0) ? 1 : ((sats + 3) / 4);
+  unsigned int sentence = 0;
+  while (sentence < total) {
+    start_sentence(e, data, "GSV,");
+    put_uint(e, total, 1);
+    put(e, ',');
+    put_uint(e, sentence + 1, 1);
+    put(e, ',');
+    put_uint(e, data->satellites_in_view, 2);
+    unsigned int i = sentence * 4;
+    while ((i < sats) && (i < ((sentence + 1) * 4))) {
+      const struct nmea_sat *const sat = &data->sats[i];
+      put(e, ',');
+      put_uint(e, sat->prn, 2);
+      put(e, ',');
+      put_uint(e, sat->elevation, 2);
+      put(e, ',');
+      put_uint(e, sat->azimuth, 3);
+      put(e, ',');
+      /* an SNR of 0 is a satellite that isn't being tracked */
+      if (sat->snr != 0) {
+        put_uint(e, sat->snr, 2);
+      }
+      ++i;
+    }
+    end_sentence(e);
+    ++sentence;
+  }
+}
+
+static void encode_rmc(struct encoder *const e,
+                       const struct nmea_data *const data) {
+  start_sentence(e, data, "RMC,");
+  put_time(e, data->time);
+  put(e, ',');
+  put(e, active(data->rmc_active));
+  put(e, ',');
+  put_angle(e, data->latitude, NMEA_FIELD_LATITUDE, 2, 'N', 'S');
+  put(e, ',');
+  put_angle(e, data->longitude, NMEA_FIELD_LONGITUDE, 3, 'E', 'W');
+  put(e, ',');
+  put_ufxp(e, data->speed, NMEA_FIELD_SPEED);
+  put(e, ',');
+  put_fxp(e, data->true_track, NMEA_FIELD_TRUE_TRACK);
+  put(e, ',');
+  put_date(e, data->time);
+  put(e, ',');
+  put_fxp_dir(e, data->magnetic_variation, NMEA_FIELD_MAGNETIC_VARIATION, 'E',
+              'W');
+  put_str(e, (data->rmc_active == NMEA_ACTIVE) ? ",A" : ",N");
+  end_sentence(e);
+}
+
+static void encode_vtg(struct encoder *const e,
+                       const struct nmea_data *const data) {
+  start_sentence(e, data, "VTG,");
+  put_fxp(e, data->true_track, NMEA_FIELD_TRUE_TRACK);
+  put_str(e, ",T,");
+  put_fxp(e, data->magnetic_track, NMEA_FIELD_MAGNETIC_TRACK);
+  put_str(e, ",M,");
+  put_ufxp(e, data->speed, NMEA_FIELD_SPEED);
+  put_str(e, ",N,");
+  /* km/h from the knots as written rather than as held, so that it is the
+   * same when encoded from the parsed knots, 1.852 km per nautical mile */
+  const unsigned char q = NMEA_FXP_FRACTIONALS[NMEA_FIELD_SPEED];
+  const unsigned char decimals = ENCODE_DECIMALS[NMEA_FIELD_SPEED];
+  const unsigned long long int scale = POW10[decimals];
+  const unsigned long long int v = round_digit(data->speed, q, decimals);
+  const unsigned long long int knots =
+      ((v >> q) * scale) +
+      (((v & ((((unsigned long long int)1) << q) - 1)) * scale) >> q);
+  const unsigned long long int kmh =
+      ((knots / 1000) * 1852) + ((((knots % 1000) * 1852) + 500) / 1000);
+  put_uint(e, kmh / scale, 1);
+  put(e, '.');
+  put_uint(e, kmh % scale, decimals);
+  put_str(e, ",K,A");
+  end_sentence(e);
+}
+
+size_t nmea_encode(const struct nmea_data *const data,
+                   const enum nmea_sentences sentence, char *const buf,
+                   const size_t len) {
+  struct encoder e = {buf, len, 0, 0};
+  switch (sentence) {
+  case NMEA_SENTENCE_GGA:
+    encode_gga(&e, data);
+    break;
+  case NMEA_SENTENCE_GLL:
+    encode_gll(&e, data);
+    break;
+  case NMEA_SENTENCE_GSA:
+    encode_gsa(&e, data);
+    break;
+  case NMEA_SENTENCE_GSV:
+    encode_gsv(&e, data);
+    break;
+  case NMEA_SENTENCE_RMC:
+    encode_rmc(&e, data);
+    break;
+  case NMEA_SENTENCE_VTG:
+    encode_vtg(&e, data);
+    break;
+  default:
+    return 0;
+  }
+  return (e.at <= len) ? e.at : 0;
+}
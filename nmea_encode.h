@@ -0,0 +1,50 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NMEA_ENCODE_H
+#define NMEA_ENCODE_H
+
+#include "nmea.h"
+
+#include <stddef.h>
+
+/*
+ * Writes data as a sentence of the given type into buf, the inverse of
+ * nmea_parse. Fixed point fields are formatted from their Q formats in
+ * NMEA_FXP_FRACTIONALS with integer arithmetic only, rounded to the nearest
+ * digit of a fixed number of decimal places:
+ *
+ *   latitude and longitude: 6 decimal places of minutes
+ *   altitude and geoid height: 2
+ *   hdop, pdop, vdop, speed, magnetic variation and tracks: 3
+ *
+ * so parsing the sentence gives the same values to within half the last
+ * decimal place plus the parser's own truncation, and encoding those values
+ * again gives the same sentence. The checksum is computed as the sentence is
+ * written, which ends with "\r\n" and is not null terminated.
+ *
+ * The talker ID is taken from data, NMEA_TALKER_OTHER is written as GP. For
+ * NMEA_SENTENCE_GSV the whole set is written, a sentence per 4 of the
+ * satellites in view, up to NMEA_MAX_SATS. Only the date of the time is
+ * written for RMC, so parsing it takes the century from the parser.
+ *
+ * Returns the number of chars written, or 0 if they don't fit in len, in which
+ * case the contents of buf are unspecified.
+ */
+size_t nmea_encode(const struct nmea_data *const data,
+                   const enum nmea_sentences sentence, char *const buf,
+                   const size_t len);
+
+#endif
@@ -0,0 +1,91 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nmea_epoch.h"
+
+#include <string.h>
+
+void nmea_epoch_init(struct nmea_epoch_assembler *const a,
+                     const nmea_sentence_bitmap_t required,
+                     const unsigned long long int timeout, nmea_epoch_fn fn,
+                     void *const ctx) {
+  memset(a, 0, sizeof(*a));
+  a->required = required;
+  a->timeout = timeout;
+  a->fn = fn;
+  a->ctx = ctx;
+}
+
+void nmea_epoch_flush(struct nmea_epoch_assembler *const a) {
+  if (a->open == 0) {
+    return;
+  }
+  a->epoch.complete =
+      ((a->epoch.sentences & a->required) == a->required) ? 1 : 0;
+  a->fn(&a->epoch, a->ctx);
+  if (a->timed != 0) {
+    a->flushed_time = a->epoch.data.time;
+    a->flushed_sentences = a->epoch.sentences;
+    a->flushed = 1;
+  }
+  memset(&a->epoch, 0, sizeof(a->epoch));
+  a->open = 0;
+  a->timed = 0;
+}
+
+void nmea_epoch_callback(const struct nmea_data *const data,
+                         const enum nmea_sentences sentence,
+                         const nmea_field_bitmap_t fields, void *const ctx) {
+  struct nmea_epoch_assembler *const a = ctx;
+  const nmea_sentence_bitmap_t mask = ((nmea_sentence_bitmap_t)1) << sentence;
+  const char timed = ((fields & NMEA_FIELD_TIME_MASK) != 0) ? 1 : 0;
+  if ((timed != 0) && (a->timed == 0) && (a->flushed != 0) &&
+      (data->time == a->flushed_time) &&
+      ((a->flushed_sentences & mask) == 0)) {
+    /* a straggler from the epoch already passed on, as are any sentences
+     * without a time since it, a repeat of one of its sentences is the next
+     * cycle of a receiver that outputs more than once a second */
+    memset(&a->epoch, 0, sizeof(a->epoch));
+    a->open = 0;
+    return;
+  }
+  if ((timed != 0) && (a->timed != 0) &&
+      ((data->time != a->epoch.data.time) ||
+       ((a->epoch.sentences & mask) != 0))) {
+    /* the epoch is over, the sentences it is missing are not coming */
+    nmea_epoch_flush(a);
+  }
+  if (a->open == 0) {
+    a->open = 1;
+    a->opened = a->now;
+  }
+  if (timed != 0) {
+    a->timed = 1;
+  }
+  nmea_data_merge(&a->epoch.data, data, fields);
+  a->epoch.fields |= fields;
+  a->epoch.sentences |= mask;
+  if ((a->epoch.sentences & a->required) == a->required) {
+    nmea_epoch_flush(a);
+  }
+}
+
+void nmea_epoch_tick(struct nmea_epoch_assembler *const a,
+                     const unsigned long long int now) {
+  a->now = now;
+  if ((a->open != 0) && ((now - a->opened) >= a->timeout)) {
+    nmea_epoch_flush(a);
+  }
+}
@@ -0,0 +1,104 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NMEA_EPOCH_H
+#define NMEA_EPOCH_H
+
+#include "nmea.h"
+
+/* the sentences received for a single fix time, merged together */
+struct nmea_epoch {
+  struct nmea_data data;
+  nmea_sentence_bitmap_t sentences;
+  /* the fields set in data, others are 0 */
+  nmea_field_bitmap_t fields;
+  /* set if every required sentence was received */
+  unsigned char complete;
+};
+
+typedef void (*nmea_epoch_fn)(const struct nmea_epoch *const epoch,
+                              void *const ctx);
+
+/*
+ * Groups sentences into epochs by the time of the sentences that carry one.
+ * Sentences without a time, such as GSA and GSV, join the epoch that is open,
+ * or open one that takes the time of the next sentence with a time.
+ *
+ * An epoch is passed to fn once every sentence in required has been received,
+ * or when a sentence with a different time arrives, or when its deadline
+ * passes. Times are in whole seconds, so for a receiver that outputs more than
+ * once a second, a second sentence with a time of a kind that the epoch already
+ * has ends it, and each cycle of the receiver gets its own epoch.
+ *
+ * Sentences that arrive after their epoch has been passed on, such as a GLL
+ * that a receiver outputs after the required sentences, are dropped rather than
+ * opening another epoch for the same time. So are any sentences without a time
+ * received between the epoch and a sentence with its time. A sentence of a kind
+ * that the epoch had opens the next one.
+ */
+struct nmea_epoch_assembler {
+  struct nmea_epoch epoch;
+  nmea_sentence_bitmap_t required;
+  nmea_epoch_fn fn;
+  void *ctx;
+  /* the time given to the last nmea_epoch_tick and the time the epoch opened */
+  unsigned long long int now;
+  unsigned long long int opened;
+  unsigned long long int timeout;
+  /* the time and sentences of the last epoch passed on, if flushed is set */
+  long long int flushed_time;
+  nmea_sentence_bitmap_t flushed_sentences;
+  unsigned char open;
+  unsigned char timed;
+  unsigned char flushed;
+};
+
+/*
+ * Initialises the assembler to pass epochs to fn once the sentences in the
+ * required mask have been received, or timeout after they open, in the units
+ * passed to nmea_epoch_tick.
+ */
+void nmea_epoch_init(struct nmea_epoch_assembler *const a,
+                     const nmea_sentence_bitmap_t required,
+                     const unsigned long long int timeout, nmea_epoch_fn fn,
+                     void *const ctx);
+
+/*
+ * The callback that feeds the assembler, register it with the assembler as its
+ * context, for all sentences and fields.
+ *
+ * for example:
+ *   const struct nmea_callback callbacks[] = {
+ *       {&nmea_epoch_callback, ~(nmea_sentence_bitmap_t)0,
+ *        ~(nmea_field_bitmap_t)0, &a}};
+ *   nmea_set_callbacks(&n, callbacks, 1);
+ */
+void nmea_epoch_callback(const struct nmea_data *const data,
+                         const enum nmea_sentences sentence,
+                         const nmea_field_bitmap_t fields, void *const ctx);
+
+/*
+ * Advances the assembler's clock to now, passing on the open epoch if it has
+ * been open for at least the timeout.
+ */
+void nmea_epoch_tick(struct nmea_epoch_assembler *const a,
+                     const unsigned long long int now);
+
+/*
+ * Passes on the open epoch, if there is one, complete or not.
+ */
+void nmea_epoch_flush(struct nmea_epoch_assembler *const a);
+
+#endif
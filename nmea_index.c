@@ -0,0 +1,180 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nmea_index.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char INDEX_MAGIC[8] = {'N', 'M', 'E', 'A', 'I', 'D', 'X', 1};
+static const uint32_t INDEX_BYTE_ORDER = 0x01020304;
+/* a 64 bit time and offset */
+static const uint32_t INDEX_ENTRY_SIZE = 16;
+
+struct index_build {
+  struct nmea_index *idx;
+  const char *buf;
+  unsigned long long int interval;
+  int rc;
+};
+
+static int index_add(struct nmea_index *const idx, const long long int time,
+                     const unsigned long long int offset) {
+  if (idx->count == idx->capacity) {
+    const size_t capacity = (idx->capacity == 0) ? 256 : (idx->capacity * 2);
+    struct nmea_index_entry *const entries =
+        realloc(idx->entries, capacity * sizeof(entries[0]));
+    if (entries == 0) {
+      return -1;
+    }
+    idx->entries = entries;
+    idx->capacity = capacity;
+  }
+  idx->entries[idx->count].time = time;
+  idx->entries[idx->count].offset = offset;
+  ++idx->count;
+  return 0;
+}
+
+static void index_sentence(struct nmea *const n, const char *const sentence,
+                           const size_t len, const nmea_field_bitmap_t fields,
+                           void *const ctx) {
+  (void)len;
+  struct index_build *const b = ctx;
+  if (((fields & NMEA_FIELD_TIME_MASK) == 0) || (b->rc != 0)) {
+    return;
+  }
+  struct nmea_index *const idx = b->idx;
+  const long long int time = n->data.time;
+  if ((idx->count != 0) &&
+      ((time < idx->entries[idx->count - 1].time) ||
+       ((unsigned long long int)(time - idx->entries[idx->count - 1].time) <
+        b->interval))) {
+    return;
+  }
+  /* a parser starting at the sentence with the time it sets ends the sentence
+   * with the same time as one that parsed from the start, as the sentence only
+   * replaces the time of day, or sets the date as well */
+  b->rc = index_add(idx, time, sentence - b->buf);
+}
+
+int nmea_index_build(struct nmea_index *const idx,
+                     const struct nmea_mmap *const m,
+                     const unsigned long long int interval) {
+  memset(idx, 0, sizeof(*idx));
+  struct index_build b = {idx, m->buf, interval, 0};
+  /* only the time and date are needed, so skip everything else */
+  struct nmea n;
+  nmea_init_subscribed(&n,
+                       NMEA_SENTENCE_GGA_MASK | NMEA_SENTENCE_GLL_MASK |
+                           NMEA_SENTENCE_RMC_MASK,
+                       NMEA_FIELD_TIME_MASK | NMEA_FIELD_DATE_MASK);
+  nmea_mmap_parse(m, &n, 0, &index_sentence, &b);
+  if (b.rc != 0) {
+    nmea_index_free(idx);
+  }
+  return b.rc;
+}
+
+int nmea_index_save(const struct nmea_index *const idx,
+                    const char *const path) {
+  FILE *const f = fopen(path, "wb");
+  if (f == 0) {
+    return -1;
+  }
+  const uint32_t header[] = {INDEX_BYTE_ORDER, INDEX_ENTRY_SIZE};
+  const uint64_t count = idx->count;
+  int rc = 0;
+  if ((fwrite(INDEX_MAGIC, sizeof(INDEX_MAGIC), 1, f) != 1) ||
+      (fwrite(header, sizeof(header), 1, f) != 1) ||
+      (fwrite(&count, sizeof(count), 1, f) != 1)) {
+    rc = -1;
+  }
+  size_t i = 0;
+  while ((rc == 0) && (i < idx->count)) {
+    const int64_t entry[] = {idx->entries[i].time,
+                             (int64_t)idx->entries[i].offset};
+    if (fwrite(entry, sizeof(entry), 1, f) != 1) {
+      rc = -1;
+    }
+    ++i;
+  }
+  if (fclose(f) != 0) {
+    rc = -1;
+  }
+  return rc;
+}
+
+int nmea_index_load(struct nmea_index *const idx, const char *const path) {
+  memset(idx, 0, sizeof(*idx));
+  FILE *const f = fopen(path, "rb");
+  if (f == 0) {
+    return -1;
+  }
+  char magic[sizeof(INDEX_MAGIC)];
+  uint32_t header[2];
+  uint64_t count;
+  if ((fread(magic, sizeof(magic), 1, f) != 1) ||
+      (memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0) ||
+      (fread(header, sizeof(header), 1, f) != 1) ||
+      (header[0] != INDEX_BYTE_ORDER) || (header[1] != INDEX_ENTRY_SIZE) ||
+      (fread(&count, sizeof(count), 1, f) != 1)) {
+    fclose(f);
+    return -1;
+  }
+  int rc = 0;
+  uint64_t i = 0;
+  while ((rc == 0) && (i < count)) {
+    int64_t entry[2];
+    if ((fread(entry, sizeof(entry), 1, f) != 1) ||
+        (index_add(idx, entry[0], entry[1]) != 0)) {
+      rc = -1;
+    }
+    ++i;
+  }
+  fclose(f);
+  if (rc != 0) {
+    nmea_index_free(idx);
+  }
+  return rc;
+}
+
+void nmea_index_free(struct nmea_index *const idx) {
+  free(idx->entries);
+  memset(idx, 0, sizeof(*idx));
+}
+
+size_t nmea_index_seek(const struct nmea_index *const idx, struct nmea *const n,
+                       const long long int time) {
+  /* binary search for the first entry after time */
+  size_t lo = 0;
+  size_t hi = idx->count;
+  while (lo < hi) {
+    const size_t mid = lo + ((hi - lo) / 2);
+    if (idx->entries[mid].time <= time) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == 0) {
+    return 0;
+  }
+  const struct nmea_index_entry *const e = &idx->entries[lo - 1];
+  n->data.time = e->time;
+  return e->offset;
+}
@@ -0,0 +1,79 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NMEA_INDEX_H
+#define NMEA_INDEX_H
+
+#include "nmea_mmap.h"
+
+/* the start of a sentence in a capture and the time after it is parsed */
+struct nmea_index_entry {
+  long long int time;
+  unsigned long long int offset;
+};
+
+/*
+ * An index of the times in an NMEA capture, so that parsing can start part way
+ * through it with the date and time that a parser would have had if it had
+ * parsed from the start.
+ */
+struct nmea_index {
+  struct nmea_index_entry *entries;
+  size_t count;
+  size_t capacity;
+};
+
+/*
+ * Parses the mapped capture, adding an entry for each sentence with a time that
+ * is at least interval seconds after the last entry's. Entries are sorted
+ * by both time and offset, times that go backwards are not indexed until they
+ * pass the last entry again. Dates are in NMEA_CENTURY. Returns 0 on success or
+ * -1 if the allocation fails.
+ */
+int nmea_index_build(struct nmea_index *const idx,
+                     const struct nmea_mmap *const m,
+                     const unsigned long long int interval);
+
+/*
+ * Writes the index to a sidecar file at path. Returns 0 on success or -1 on
+ * failure.
+ */
+int nmea_index_save(const struct nmea_index *const idx, const char *const path);
+
+/*
+ * Reads an index written by nmea_index_save. Returns 0 on success or -1 if the
+ * file can't be read or is not an index in this byte order.
+ */
+int nmea_index_load(struct nmea_index *const idx, const char *const path);
+
+/*
+ * Frees the memory allocated by nmea_index_build or nmea_index_load.
+ */
+void nmea_index_free(struct nmea_index *const idx);
+
+/*
+ * Finds the last entry at or before time and sets the time of n, which should
+ * be newly initialised, to the entry's. Returns the offset of the entry's
+ * sentence to start parsing the capture from, the first time parsed is the
+ * entry's. Returns 0 with n unchanged if time is before the first entry.
+ *
+ * for example:
+ *   nmea_init(&n);
+ *   nmea_mmap_parse(&m, &n, nmea_index_seek(&idx, &n, time), fn, ctx);
+ */
+size_t nmea_index_seek(const struct nmea_index *const idx, struct nmea *const n,
+                       const long long int time);
+
+#endif
@@ -0,0 +1,430 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nmea_log.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char LOG_MAGIC[8] = {'N', 'M', 'E', 'A', 'L', 'O', 'G', 2};
+static const uint32_t LOG_BYTE_ORDER = 0x01020304;
+static const uint32_t LOG_BLOCK_MAGIC = 0x4b4c424e;
+static const size_t LOG_HEADER_SIZE = 16;
+
+/* the magic number, record count and the count of each sparse column, padded
+ * to 8 bytes */
+#define LOG_BLOCK_HEADER_WORDS ((2 + NMEA_LOG_COLUMNS + 1) & ~1)
+
+/* the size of a value in each sparse column */
+static const unsigned char LOG_COLUMN_SIZES[NMEA_LOG_COLUMNS] = {
+    [NMEA_LOG_TIME] = 8,
+    [NMEA_LOG_LATITUDE] = 8,
+    [NMEA_LOG_LONGITUDE] = 8,
+    [NMEA_LOG_MAGNETIC_VARIATION] = 8,
+    [NMEA_LOG_ALTITUDE] = 4,
+    [NMEA_LOG_GEOID_HEIGHT] = 4,
+    [NMEA_LOG_TRUE_TRACK] = 4,
+    [NMEA_LOG_MAGNETIC_TRACK] = 4,
+    [NMEA_LOG_HDOP] = 4,
+    [NMEA_LOG_PDOP] = 4,
+    [NMEA_LOG_VDOP] = 4,
+    [NMEA_LOG_SPEED] = 4,
+    [NMEA_LOG_SATELLITES_TRACKED] = 2,
+    [NMEA_LOG_SATELLITES_IN_VIEW] = 2,
+    [NMEA_LOG_FIX_QUALITY] = 1,
+    [NMEA_LOG_FIX_3D] = 1,
+    [NMEA_LOG_GLL_ACTIVE] = 1,
+    [NMEA_LOG_RMC_ACTIVE] = 1,
+    [NMEA_LOG_PRNS_TRACKED] = NMEA_MAX_PRNS_TRACKED};
+
+/* the fields that give each sparse column a value, the same as those that
+ * nmea_data_merge copies it for */
+static const nmea_field_bitmap_t LOG_COLUMN_FIELDS[NMEA_LOG_COLUMNS] = {
+    [NMEA_LOG_TIME] = NMEA_FIELD_TIME_MASK | NMEA_FIELD_DATE_MASK,
+    [NMEA_LOG_LATITUDE] =
+        NMEA_FIELD_LATITUDE_MASK | NMEA_FIELD_LATITUDE_DIR_MASK,
+    [NMEA_LOG_LONGITUDE] =
+        NMEA_FIELD_LONGITUDE_MASK | NMEA_FIELD_LONGITUDE_DIR_MASK,
+    [NMEA_LOG_MAGNETIC_VARIATION] = NMEA_FIELD_MAGNETIC_VARIATION_MASK |
+                                    NMEA_FIELD_MAGNETIC_VARIATION_DIR_MASK,
+    [NMEA_LOG_ALTITUDE] = NMEA_FIELD_ALTITUDE_MASK,
+    [NMEA_LOG_GEOID_HEIGHT] = NMEA_FIELD_GEOID_HEIGHT_MASK,
+    [NMEA_LOG_TRUE_TRACK] = NMEA_FIELD_TRUE_TRACK_MASK,
+    [NMEA_LOG_MAGNETIC_TRACK] = NMEA_FIELD_MAGNETIC_TRACK_MASK,
+    [NMEA_LOG_HDOP] = NMEA_FIELD_HDOP_MASK,
+    [NMEA_LOG_PDOP] = NMEA_FIELD_PDOP_MASK,
+    [NMEA_LOG_VDOP] = NMEA_FIELD_VDOP_MASK,
+    [NMEA_LOG_SPEED] = NMEA_FIELD_SPEED_MASK,
+    [NMEA_LOG_SATELLITES_TRACKED] = NMEA_FIELD_SATELLITES_TRACKED_MASK,
+    [NMEA_LOG_SATELLITES_IN_VIEW] = NMEA_FIELD_SATELLITES_IN_VIEW_MASK,
+    [NMEA_LOG_FIX_QUALITY] = NMEA_FIELD_FIX_QUALITY_MASK,
+    [NMEA_LOG_FIX_3D] = NMEA_FIELD_FIX_3D_MASK,
+    [NMEA_LOG_GLL_ACTIVE] = NMEA_FIELD_GLL_ACTIVE_MASK,
+    [NMEA_LOG_RMC_ACTIVE] = NMEA_FIELD_RMC_ACTIVE_MASK,
+    [NMEA_LOG_PRNS_TRACKED] = NMEA_FIELD_PRNS_TRACKED_MASK};
+
+/* the size of count values of size bytes, padded so the next column is
+ * aligned */
+static size_t column_size(const size_t count, const size_t size) {
+  return ((count * size) + 7) & ~(size_t)7;
+}
+
+/* the size of the buffer for capacity records with every column full, with
+ * each column padded as in the file so a block is compacted towards its start
+ */
+static size_t buffer_size(const size_t capacity) {
+  size_t size = column_size(capacity, sizeof(uint32_t)) +
+                column_size(capacity, sizeof(uint8_t));
+  size_t i = 0;
+  while (i < NMEA_LOG_COLUMNS) {
+    size += column_size(capacity, LOG_COLUMN_SIZES[i]);
+    ++i;
+  }
+  return size;
+}
+
+static uint32_t clamp_u32(const unsigned long int v) {
+  return (v > UINT32_MAX) ? UINT32_MAX : (uint32_t)v;
+}
+
+static int32_t clamp_i32(const long int v) {
+  return (v > INT32_MAX) ? INT32_MAX : ((v < INT32_MIN) ? INT32_MIN : v);
+}
+
+int nmea_log_writer_open(struct nmea_log_writer *const w,
+                         const char *const path, size_t block_records) {
+  memset(w, 0, sizeof(*w));
+  if (block_records == 0) {
+    block_records = NMEA_LOG_BLOCK_RECORDS;
+  }
+  w->capacity = block_records;
+  w->buf = malloc(buffer_size(w->capacity));
+  if (w->buf == 0) {
+    return -1;
+  }
+  w->f = fopen(path, "wb");
+  if (w->f == 0) {
+    free(w->buf);
+    w->buf = 0;
+    return -1;
+  }
+  const uint32_t header[] = {LOG_BYTE_ORDER, NMEA_LOG_COLUMNS};
+  if ((fwrite(LOG_MAGIC, sizeof(LOG_MAGIC), 1, w->f) != 1) ||
+      (fwrite(header, sizeof(header), 1, w->f) != 1)) {
+    w->rc = -1;
+  }
+  return 0;
+}
+
+/* moves a column of count values from src to dst, zeroing its padding, returns
+ * the end of the column at dst */
+static unsigned char *compact(unsigned char *const dst,
+                              const unsigned char *const src,
+                              const size_t count, const size_t size) {
+  const size_t len = count * size;
+  const size_t padded = column_size(count, size);
+  memmove(dst, src, len);
+  memset(&dst[len], 0, padded - len);
+  return &dst[padded];
+}
+
+/* compacts the columns of the buffered records, then writes them out */
+static void log_flush(struct nmea_log_writer *const w) {
+  if (w->count == 0) {
+    return;
+  }
+  uint32_t header[LOG_BLOCK_HEADER_WORDS];
+  memset(header, 0, sizeof(header));
+  header[0] = LOG_BLOCK_MAGIC;
+  header[1] = (uint32_t)w->count;
+  const unsigned char *src = w->buf;
+  unsigned char *dst = compact(w->buf, src, w->count, sizeof(uint32_t));
+  src += column_size(w->capacity, sizeof(uint32_t));
+  dst = compact(dst, src, w->count, sizeof(uint8_t));
+  src += column_size(w->capacity, sizeof(uint8_t));
+  size_t i = 0;
+  while (i < NMEA_LOG_COLUMNS) {
+    header[2 + i] = (uint32_t)w->counts[i];
+    dst = compact(dst, src, w->counts[i], LOG_COLUMN_SIZES[i]);
+    src += column_size(w->capacity, LOG_COLUMN_SIZES[i]);
+    w->counts[i] = 0;
+    ++i;
+  }
+  if ((fwrite(header, sizeof(header), 1, w->f) != 1) ||
+      (fwrite(w->buf, dst - w->buf, 1, w->f) != 1)) {
+    w->rc = -1;
+  }
+  w->count = 0;
+}
+
+void nmea_log_write(struct nmea_log_writer *const w,
+                    const struct nmea_data *const data,
+                    const nmea_field_bitmap_t fields) {
+  const int64_t time = data->time;
+  const int64_t latitude = data->latitude;
+  const int64_t longitude = data->longitude;
+  const int64_t magnetic_variation = data->magnetic_variation;
+  const int32_t altitude = clamp_i32(data->altitude);
+  const int32_t geoid_height = clamp_i32(data->geoid_height);
+  const int32_t true_track = clamp_i32(data->true_track);
+  const int32_t magnetic_track = clamp_i32(data->magnetic_track);
+  const uint32_t hdop = clamp_u32(data->hdop);
+  const uint32_t pdop = clamp_u32(data->pdop);
+  const uint32_t vdop = clamp_u32(data->vdop);
+  const uint32_t speed = clamp_u32(data->speed);
+  const uint16_t satellites_tracked = data->satellites_tracked;
+  const uint16_t satellites_in_view = data->satellites_in_view;
+  const uint8_t fix_quality = data->fix_quality;
+  const uint8_t fix_3d = data->fix_3d;
+  const uint8_t gll_active = data->gll_active;
+  const uint8_t rmc_active = data->rmc_active;
+  const void *const values[NMEA_LOG_COLUMNS] = {
+      [NMEA_LOG_TIME] = &time,
+      [NMEA_LOG_LATITUDE] = &latitude,
+      [NMEA_LOG_LONGITUDE] = &longitude,
+      [NMEA_LOG_MAGNETIC_VARIATION] = &magnetic_variation,
+      [NMEA_LOG_ALTITUDE] = &altitude,
+      [NMEA_LOG_GEOID_HEIGHT] = &geoid_height,
+      [NMEA_LOG_TRUE_TRACK] = &true_track,
+      [NMEA_LOG_MAGNETIC_TRACK] = &magnetic_track,
+      [NMEA_LOG_HDOP] = &hdop,
+      [NMEA_LOG_PDOP] = &pdop,
+      [NMEA_LOG_VDOP] = &vdop,
+      [NMEA_LOG_SPEED] = &speed,
+      [NMEA_LOG_SATELLITES_TRACKED] = &satellites_tracked,
+      [NMEA_LOG_SATELLITES_IN_VIEW] = &satellites_in_view,
+      [NMEA_LOG_FIX_QUALITY] = &fix_quality,
+      [NMEA_LOG_FIX_3D] = &fix_3d,
+      [NMEA_LOG_GLL_ACTIVE] = &gll_active,
+      [NMEA_LOG_RMC_ACTIVE] = &rmc_active,
+      [NMEA_LOG_PRNS_TRACKED] = data->prns_tracked};
+
+  const size_t cap = w->capacity;
+  const uint32_t fields32 = (uint32_t)fields;
+  const uint8_t talker = data->talker;
+  unsigned char *col = w->buf;
+  memcpy(&col[w->count * sizeof(fields32)], &fields32, sizeof(fields32));
+  col += column_size(cap, sizeof(fields32));
+  memcpy(&col[w->count * sizeof(talker)], &talker, sizeof(talker));
+  col += column_size(cap, sizeof(talker));
+  size_t i = 0;
+  while (i < NMEA_LOG_COLUMNS) {
+    const size_t size = LOG_COLUMN_SIZES[i];
+    if ((fields & LOG_COLUMN_FIELDS[i]) != 0) {
+      memcpy(&col[w->counts[i] * size], values[i], size);
+      ++w->counts[i];
+    }
+    col += column_size(cap, size);
+    ++i;
+  }
+
+  ++w->count;
+  if (w->count == cap) {
+    log_flush(w);
+  }
+}
+
+void nmea_log_callback(const struct nmea_data *const data,
+                       const enum nmea_sentences sentence,
+                       const nmea_field_bitmap_t fields, void *const ctx) {
+  (void)sentence;
+  nmea_log_write(ctx, data, fields);
+}
+
+int nmea_log_writer_close(struct nmea_log_writer *const w) {
+  log_flush(w);
+  if (fclose(w->f) != 0) {
+    w->rc = -1;
+  }
+  free(w->buf);
+  const int rc = w->rc;
+  memset(w, 0, sizeof(*w));
+  return rc;
+}
+
+int nmea_log_open(struct nmea_log_reader *const r, const char *const path) {
+  r->offset = LOG_HEADER_SIZE;
+  if (nmea_mmap_open(&r->m, path) != 0) {
+    return -1;
+  }
+  uint32_t header[2];
+  if (r->m.len >= LOG_HEADER_SIZE) {
+    memcpy(header, &r->m.buf[sizeof(LOG_MAGIC)], sizeof(header));
+  }
+  if ((r->m.len < LOG_HEADER_SIZE) ||
+      (memcmp(r->m.buf, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0) ||
+      (header[0] != LOG_BYTE_ORDER) || (header[1] != NMEA_LOG_COLUMNS)) {
+    nmea_mmap_close(&r->m);
+    return -1;
+  }
+  return 0;
+}
+
+int nmea_log_next(struct nmea_log_reader *const r,
+                  struct nmea_log_block *const b) {
+  const size_t remaining = r->m.len - r->offset;
+  if (remaining == 0) {
+    return 0;
+  }
+  uint32_t header[LOG_BLOCK_HEADER_WORDS];
+  if (remaining < sizeof(header)) {
+    return -1;
+  }
+  memcpy(header, &r->m.buf[r->offset], sizeof(header));
+  const size_t count = header[1];
+  if (header[0] != LOG_BLOCK_MAGIC) {
+    return -1;
+  }
+  const char *const base = &r->m.buf[r->offset];
+  size_t len = sizeof(header);
+  b->fields = (const uint32_t *)&base[len];
+  len += column_size(count, sizeof(uint32_t));
+  b->talker = (const uint8_t *)&base[len];
+  len += column_size(count, sizeof(uint8_t));
+  const char *cols[NMEA_LOG_COLUMNS];
+  size_t i = 0;
+  while (i < NMEA_LOG_COLUMNS) {
+    b->counts[i] = header[2 + i];
+    if (b->counts[i] > count) {
+      return -1;
+    }
+    cols[i] = &base[len];
+    len += column_size(b->counts[i], LOG_COLUMN_SIZES[i]);
+    b->next[i] = 0;
+    ++i;
+  }
+  if (len > remaining) {
+    return -1;
+  }
+  r->offset += len;
+
+  /* the columns are 8 byte aligned in a page aligned mapping, so can be used
+   * in place */
+  b->count = count;
+  b->record = 0;
+  b->time = (const int64_t *)cols[NMEA_LOG_TIME];
+  b->latitude = (const int64_t *)cols[NMEA_LOG_LATITUDE];
+  b->longitude = (const int64_t *)cols[NMEA_LOG_LONGITUDE];
+  b->magnetic_variation = (const int64_t *)cols[NMEA_LOG_MAGNETIC_VARIATION];
+  b->altitude = (const int32_t *)cols[NMEA_LOG_ALTITUDE];
+  b->geoid_height = (const int32_t *)cols[NMEA_LOG_GEOID_HEIGHT];
+  b->true_track = (const int32_t *)cols[NMEA_LOG_TRUE_TRACK];
+  b->magnetic_track = (const int32_t *)cols[NMEA_LOG_MAGNETIC_TRACK];
+  b->hdop = (const uint32_t *)cols[NMEA_LOG_HDOP];
+  b->pdop = (const uint32_t *)cols[NMEA_LOG_PDOP];
+  b->vdop = (const uint32_t *)cols[NMEA_LOG_VDOP];
+  b->speed = (const uint32_t *)cols[NMEA_LOG_SPEED];
+  b->satellites_tracked = (const uint16_t *)cols[NMEA_LOG_SATELLITES_TRACKED];
+  b->satellites_in_view = (const uint16_t *)cols[NMEA_LOG_SATELLITES_IN_VIEW];
+  b->fix_quality = (const uint8_t *)cols[NMEA_LOG_FIX_QUALITY];
+  b->fix_3d = (const uint8_t *)cols[NMEA_LOG_FIX_3D];
+  b->gll_active = (const uint8_t *)cols[NMEA_LOG_GLL_ACTIVE];
+  b->rmc_active = (const uint8_t *)cols[NMEA_LOG_RMC_ACTIVE];
+  b->prns_tracked =
+      (const uint8_t(*)[NMEA_MAX_PRNS_TRACKED])cols[NMEA_LOG_PRNS_TRACKED];
+  return 1;
+}
+
+void nmea_log_close(struct nmea_log_reader *const r) {
+  nmea_mmap_close(&r->m);
+  r->offset = 0;
+}
+
+/* if the record set the column's fields, sets i to the index of its value and
+ * returns 1, a corrupt block that claims more values than the column holds
+ * leaves the field zeroed */
+static int next_value(struct nmea_log_block *const b,
+                      const enum nmea_log_columns column,
+                      const nmea_field_bitmap_t fields, size_t *const i) {
+  if (((fields & LOG_COLUMN_FIELDS[column]) == 0) ||
+      (b->next[column] >= b->counts[column])) {
+    return 0;
+  }
+  *i = b->next[column];
+  ++b->next[column];
+  return 1;
+}
+
+nmea_field_bitmap_t nmea_log_record(struct nmea_log_block *const b,
+                                    struct nmea_data *const data) {
+  memset(data, 0, sizeof(*data));
+  if (b->record >= b->count) {
+    return 0;
+  }
+  const nmea_field_bitmap_t fields = b->fields[b->record];
+  data->talker = b->talker[b->record];
+  ++b->record;
+  size_t i;
+  if (next_value(b, NMEA_LOG_TIME, fields, &i) != 0) {
+    data->time = b->time[i];
+  }
+  if (next_value(b, NMEA_LOG_LATITUDE, fields, &i) != 0) {
+    data->latitude = b->latitude[i];
+  }
+  if (next_value(b, NMEA_LOG_LONGITUDE, fields, &i) != 0) {
+    data->longitude = b->longitude[i];
+  }
+  if (next_value(b, NMEA_LOG_MAGNETIC_VARIATION, fields, &i) != 0) {
+    data->magnetic_variation = b->magnetic_variation[i];
+  }
+  if (next_value(b, NMEA_LOG_ALTITUDE, fields, &i) != 0) {
+    data->altitude = b->altitude[i];
+  }
+  if (next_value(b, NMEA_LOG_GEOID_HEIGHT, fields, &i) != 0) {
+    data->geoid_height = b->geoid_height[i];
+  }
+  if (next_value(b, NMEA_LOG_TRUE_TRACK, fields, &i) != 0) {
+    data->true_track = b->true_track[i];
+  }
+  if (next_value(b, NMEA_LOG_MAGNETIC_TRACK, fields, &i) != 0) {
+    data->magnetic_track = b->magnetic_track[i];
+  }
+  if (next_value(b, NMEA_LOG_HDOP, fields, &i) != 0) {
+    data->hdop = b->hdop[i];
+  }
+  if (next_value(b, NMEA_LOG_PDOP, fields, &i) != 0) {
+    data->pdop = b->pdop[i];
+  }
+  if (next_value(b, NMEA_LOG_VDOP, fields, &i) != 0) {
+    data->vdop = b->vdop[i];
+  }
+  if (next_value(b, NMEA_LOG_SPEED, fields, &i) != 0) {
+    data->speed = b->speed[i];
+  }
+  if (next_value(b, NMEA_LOG_SATELLITES_TRACKED, fields, &i) != 0) {
+    data->satellites_tracked = b->satellites_tracked[i];
+  }
+  if (next_value(b, NMEA_LOG_SATELLITES_IN_VIEW, fields, &i) != 0) {
+    data->satellites_in_view = b->satellites_in_view[i];
+  }
+  if (next_value(b, NMEA_LOG_FIX_QUALITY, fields, &i) != 0) {
+    data->fix_quality = b->fix_quality[i];
+  }
+  if (next_value(b, NMEA_LOG_FIX_3D, fields, &i) != 0) {
+    data->fix_3d = b->fix_3d[i];
+  }
+  if (next_value(b, NMEA_LOG_GLL_ACTIVE, fields, &i) != 0) {
+    data->gll_active = b->gll_active[i];
+  }
+  if (next_value(b, NMEA_LOG_RMC_ACTIVE, fields, &i) != 0) {
+    data->rmc_active = b->rmc_active[i];
+  }
+  if (next_value(b, NMEA_LOG_PRNS_TRACKED, fields, &i) != 0) {
+    memcpy(data->prns_tracked, b->prns_tracked[i],
+           sizeof(data->prns_tracked));
+  }
+  return fields;
+}
@@ -0,0 +1,188 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NMEA_LOG_H
+#define NMEA_LOG_H
+
+#include "nmea_mmap.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* the records in each block unless another size is given to the writer */
+#define NMEA_LOG_BLOCK_RECORDS (4096)
+
+/*
+ * A binary log of decoded sentences, one record per sentence holding the
+ * fields it set in their fixed point form, so it can be replayed without
+ * parsing. Records are stored in blocks with a column per field, each column
+ * aligned to 8 bytes, so a block can be read in place from a mapped file and a
+ * scan of one field only touches that field's memory.
+ *
+ * Every record has its fields bitmap and talker. The other columns only hold a
+ * value for the records that set their field, in record order, so a GSV record
+ * is its satellites in view alone rather than a zeroed position and time. A
+ * typical record is under half the size of its sentence.
+ *
+ * The file is a 16 byte header, "NMEALOG" and a version byte followed by a
+ * 32 bit byte order mark and a 32 bit number of sparse columns. Each block is
+ * a 32 bit magic number, a 32 bit record count and a 32 bit value count per
+ * sparse column, padded to 8 bytes, followed by the fields and talker columns
+ * and then the sparse columns in the order of enum nmea_log_columns. Values are
+ * stored in the writer's byte order, a reader with a different byte order
+ * rejects the file.
+ *
+ * hdop, pdop, vdop, speed, altitude, geoid height and the tracks are stored in
+ * 32 bits, which holds any value a receiver outputs, larger values are
+ * clamped. The azimuth, elevation and SNR of each satellite are not stored.
+ */
+
+/* the columns that only hold values for the records that set them */
+enum nmea_log_columns {
+  NMEA_LOG_TIME = 0,
+  NMEA_LOG_LATITUDE,
+  NMEA_LOG_LONGITUDE,
+  NMEA_LOG_MAGNETIC_VARIATION,
+  NMEA_LOG_ALTITUDE,
+  NMEA_LOG_GEOID_HEIGHT,
+  NMEA_LOG_TRUE_TRACK,
+  NMEA_LOG_MAGNETIC_TRACK,
+  NMEA_LOG_HDOP,
+  NMEA_LOG_PDOP,
+  NMEA_LOG_VDOP,
+  NMEA_LOG_SPEED,
+  NMEA_LOG_SATELLITES_TRACKED,
+  NMEA_LOG_SATELLITES_IN_VIEW,
+  NMEA_LOG_FIX_QUALITY,
+  NMEA_LOG_FIX_3D,
+  NMEA_LOG_GLL_ACTIVE,
+  NMEA_LOG_RMC_ACTIVE,
+  NMEA_LOG_PRNS_TRACKED,
+  NMEA_LOG_COLUMNS
+};
+
+/* a block of records, with a pointer to the start of each column */
+struct nmea_log_block {
+  size_t count;
+  const uint32_t *fields;
+  const uint8_t *talker;
+  /* the number of values in each sparse column */
+  size_t counts[NMEA_LOG_COLUMNS];
+  const int64_t *time;
+  const int64_t *latitude;
+  const int64_t *longitude;
+  const int64_t *magnetic_variation;
+  const int32_t *altitude;
+  const int32_t *geoid_height;
+  const int32_t *true_track;
+  const int32_t *magnetic_track;
+  const uint32_t *hdop;
+  const uint32_t *pdop;
+  const uint32_t *vdop;
+  const uint32_t *speed;
+  const uint16_t *satellites_tracked;
+  const uint16_t *satellites_in_view;
+  const uint8_t *fix_quality;
+  const uint8_t *fix_3d;
+  const uint8_t *gll_active;
+  const uint8_t *rmc_active;
+  const uint8_t (*prns_tracked)[NMEA_MAX_PRNS_TRACKED];
+  /* the next record read by nmea_log_record and its value in each column */
+  size_t record;
+  size_t next[NMEA_LOG_COLUMNS];
+};
+
+struct nmea_log_writer {
+  FILE *f;
+  /* a block of capacity records, in the file's layout */
+  unsigned char *buf;
+  size_t capacity;
+  size_t count;
+  /* the values buffered in each sparse column */
+  size_t counts[NMEA_LOG_COLUMNS];
+  /* set if a write has failed */
+  int rc;
+};
+
+struct nmea_log_reader {
+  struct nmea_mmap m;
+  size_t offset;
+};
+
+/*
+ * Creates the file at path and writes the header, records are written in
+ * blocks of block_records, or NMEA_LOG_BLOCK_RECORDS if 0. Returns 0 on
+ * success or -1 on failure.
+ */
+int nmea_log_writer_open(struct nmea_log_writer *const w,
+                         const char *const path, size_t block_records);
+
+/*
+ * Adds a record of data and the fields that were set in it, writing the block
+ * out once it is full.
+ */
+void nmea_log_write(struct nmea_log_writer *const w,
+                    const struct nmea_data *const data,
+                    const nmea_field_bitmap_t fields);
+
+/*
+ * A callback that writes a record as each sentence completes, register it with
+ * the writer as its context.
+ *
+ * for example:
+ *   const struct nmea_callback callbacks[] = {
+ *       {&nmea_log_callback, ~(nmea_sentence_bitmap_t)0,
+ *        ~(nmea_field_bitmap_t)0, &w}};
+ *   nmea_set_callbacks(&n, callbacks, 1);
+ */
+void nmea_log_callback(const struct nmea_data *const data,
+                       const enum nmea_sentences sentence,
+                       const nmea_field_bitmap_t fields, void *const ctx);
+
+/*
+ * Writes out the last block and closes the file. Returns 0 if every write
+ * succeeded or -1 otherwise.
+ */
+int nmea_log_writer_close(struct nmea_log_writer *const w);
+
+/*
+ * Maps the log at path into memory and checks its header. Returns 0 on success
+ * or -1 if the file can't be mapped or is not a log in this byte order.
+ */
+int nmea_log_open(struct nmea_log_reader *const r, const char *const path);
+
+/*
+ * Points the columns of b at the next block in the mapped file, they are valid
+ * until the log is closed. Returns 1 for a block, 0 at the end of the log or -1
+ * if the block is corrupt or truncated.
+ */
+int nmea_log_next(struct nmea_log_reader *const r,
+                  struct nmea_log_block *const b);
+
+/*
+ * Unmaps a log opened by nmea_log_open.
+ */
+void nmea_log_close(struct nmea_log_reader *const r);
+
+/*
+ * Copies the next record of b into data, the fields that the record didn't set
+ * and those that are not stored are zeroed. Records are read in order, from
+ * the first after nmea_log_next, and b->count of them can be read. Returns the
+ * fields that were set by the record's sentence.
+ */
+nmea_field_bitmap_t nmea_log_record(struct nmea_log_block *const b,
+                                    struct nmea_data *const data);
+
+#endif
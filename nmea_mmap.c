@@ -0,0 +1,85 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* must be defined before any system headers are included */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "nmea_mmap.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int nmea_mmap_open(struct nmea_mmap *const m, const char *const path) {
+  memset(m, 0, sizeof(*m));
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return -1;
+  }
+  if (st.st_size == 0) {
+    /* an empty file can't be mapped */
+    close(fd);
+    return 0;
+  }
+  void *const buf = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  /* the mapping holds its own reference to the file */
+  close(fd);
+  if (buf == MAP_FAILED) {
+    return -1;
+  }
+  /* the advice is only a hint, so failing to give it is not an error */
+  (void)posix_madvise(buf, st.st_size, POSIX_MADV_SEQUENTIAL);
+  m->buf = buf;
+  m->len = st.st_size;
+  return 0;
+}
+
+void nmea_mmap_close(struct nmea_mmap *const m) {
+  if (m->buf != 0) {
+    munmap((void *)m->buf, m->len);
+  }
+  memset(m, 0, sizeof(*m));
+}
+
+void nmea_mmap_parse(const struct nmea_mmap *const m, struct nmea *const n,
+                     const size_t offset, nmea_mmap_fn fn, void *const ctx) {
+  size_t i = offset;
+  while (i < m->len) {
+    i += nmea_parse_buf(n, &m->buf[i], m->len - i);
+    const nmea_field_bitmap_t fields = n->state.received;
+    if (fields == 0) {
+      continue;
+    }
+    nmea_decode(n, fields);
+    n->state.received = 0;
+    /* the sentence ends with the char that completed it, search back for its
+     * start */
+    size_t start = i;
+    while ((start > 0) && (m->buf[start - 1] != '$')) {
+      --start;
+    }
+    start = (start > 0) ? (start - 1) : 0;
+    fn(n, &m->buf[start], i - start, fields, ctx);
+  }
+}
@@ -0,0 +1,57 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NMEA_MMAP_H
+#define NMEA_MMAP_H
+
+#include "nmea.h"
+
+/* a file mapped into memory, buf is 0 for an empty file */
+struct nmea_mmap {
+  const char *buf;
+  size_t len;
+};
+
+/*
+ * Called for each sentence that sets fields. sentence points at the sentence
+ * in the mapped file, from its '$' up to the end of its checksum, and is valid
+ * until the file is closed. fields holds the fields that the sentence set, with
+ * their values in n->data.
+ */
+typedef void (*nmea_mmap_fn)(struct nmea *const n, const char *const sentence,
+                             const size_t len, const nmea_field_bitmap_t fields,
+                             void *const ctx);
+
+/*
+ * Maps the file at path into memory read only, advising the kernel that it
+ * will be read in order. Returns 0 on success or -1 on failure.
+ */
+int nmea_mmap_open(struct nmea_mmap *const m, const char *const path);
+
+/*
+ * Unmaps a file mapped by nmea_mmap_open.
+ */
+void nmea_mmap_close(struct nmea_mmap *const m);
+
+/*
+ * Parses the mapped file with n from offset to the end, passing each sentence
+ * that sets fields to fn. The fields are consumed from n->state.received
+ * before fn is called. Parsing can start at any offset, the parser skips to
+ * the start of the next sentence.
+ */
+void nmea_mmap_parse(const struct nmea_mmap *const m, struct nmea *const n,
+                     const size_t offset, nmea_mmap_fn fn, void *const ctx);
+
+#endif
@@ -0,0 +1,367 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* must be defined before any system headers are included */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "nmea_parallel.h"
+
+#include "nmea_mmap.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const long long int SECONDS_IN_DAY = 86400;
+
+/* the chunks that can be parsed ahead of those passed on, per thread */
+#define CHUNKS_PER_THREAD (2)
+
+#define RECORD_VALUE(mask, member)                                             \
+  { (mask), offsetof(struct nmea_data, member),                                \
+    sizeof(((struct nmea_data *)0)->member) }
+
+/* the values stored in a record if any of the fields in their mask were set,
+ * the same as those that nmea_data_merge copies */
+static const struct {
+  nmea_field_bitmap_t fields;
+  size_t offset;
+  size_t size;
+} RECORD_VALUES[] = {
+    RECORD_VALUE(~(nmea_field_bitmap_t)0, talker),
+    RECORD_VALUE(NMEA_FIELD_LONGITUDE_MASK | NMEA_FIELD_LONGITUDE_DIR_MASK,
+                 longitude),
+    RECORD_VALUE(NMEA_FIELD_LATITUDE_MASK | NMEA_FIELD_LATITUDE_DIR_MASK,
+                 latitude),
+    RECORD_VALUE(NMEA_FIELD_FIX_QUALITY_MASK, fix_quality),
+    RECORD_VALUE(NMEA_FIELD_SATELLITES_TRACKED_MASK, satellites_tracked),
+    RECORD_VALUE(NMEA_FIELD_SATELLITES_IN_VIEW_MASK, satellites_in_view),
+    RECORD_VALUE(NMEA_FIELD_ALTITUDE_MASK, altitude),
+    RECORD_VALUE(NMEA_FIELD_GEOID_HEIGHT_MASK, geoid_height),
+    RECORD_VALUE(NMEA_FIELD_FIX_3D_MASK, fix_3d),
+    RECORD_VALUE(NMEA_FIELD_PRNS_TRACKED_MASK, prns_tracked),
+    RECORD_VALUE(NMEA_FIELD_PRN_MASK | NMEA_FIELD_AZIMUTH_MASK |
+                     NMEA_FIELD_ELEVATION_MASK | NMEA_FIELD_SNR_MASK,
+                 sats),
+    RECORD_VALUE(NMEA_FIELD_PDOP_MASK, pdop),
+    RECORD_VALUE(NMEA_FIELD_HDOP_MASK, hdop),
+    RECORD_VALUE(NMEA_FIELD_VDOP_MASK, vdop),
+    RECORD_VALUE(NMEA_FIELD_GLL_ACTIVE_MASK, gll_active),
+    RECORD_VALUE(NMEA_FIELD_RMC_ACTIVE_MASK, rmc_active),
+    RECORD_VALUE(NMEA_FIELD_SPEED_MASK, speed),
+    RECORD_VALUE(NMEA_FIELD_TIME_MASK | NMEA_FIELD_DATE_MASK, time),
+    RECORD_VALUE(NMEA_FIELD_MAGNETIC_VARIATION_MASK |
+                     NMEA_FIELD_MAGNETIC_VARIATION_DIR_MASK,
+                 magnetic_variation),
+    RECORD_VALUE(NMEA_FIELD_TRUE_TRACK_MASK, true_track),
+    RECORD_VALUE(NMEA_FIELD_MAGNETIC_TRACK_MASK, magnetic_track)};
+
+#define RECORD_VALUES_COUNT (sizeof(RECORD_VALUES) / sizeof(RECORD_VALUES[0]))
+
+/* the records of a chunk, each the fields set by a sentence followed by the
+ * values of those fields in the order of RECORD_VALUES */
+struct chunk {
+  size_t start;
+  size_t end;
+  unsigned char *records;
+  size_t len;
+  size_t capacity;
+  size_t count;
+  /* the records before the first with a date */
+  size_t undated;
+  int rc;
+  /* set once the chunk has been parsed */
+  unsigned char done;
+};
+
+struct parallel {
+  struct nmea_mmap m;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  /* chunk i is parsed into chunks[i % window] */
+  struct chunk *chunks;
+  size_t window;
+  size_t chunk_len;
+  /* the start of the next chunk to parse */
+  size_t next;
+  /* the chunks taken by the threads and those passed on */
+  size_t claimed;
+  size_t merged;
+  /* set if a chunk failed, so no more should be taken */
+  unsigned char stop;
+};
+
+/* sentences that continue a GSV set can't start a chunk as their parser would
+ * never complete the set, len is the rest of the file */
+static char is_boundary(const char *const p, const size_t len) {
+  /* "$GPGSV,2,1," */
+  if ((len < 10) || (memcmp(&p[3], "GSV,", 4) != 0)) {
+    return 1;
+  }
+  const char *const no = memchr(&p[7], ',', len - 7);
+  return ((no == 0) || (((no + 1) - p) >= (long int)len) || (no[1] == '1') ||
+          (no[1] == ','))
+             ? 1
+             : 0;
+}
+
+/* returns the offset of the first chunk boundary at or after from */
+static size_t find_boundary(const struct nmea_mmap *const m, size_t from) {
+  while (from < m->len) {
+    const char *const p = memchr(&m->buf[from], '$', m->len - from);
+    if (p == 0) {
+      break;
+    }
+    from = p - m->buf;
+    if (is_boundary(p, m->len - from) != 0) {
+      return from;
+    }
+    ++from;
+  }
+  return m->len;
+}
+
+/* appends a record of the values of the fields that the sentence set */
+static int chunk_record(struct chunk *const c,
+                        const struct nmea_data *const data,
+                        const nmea_field_bitmap_t fields) {
+  size_t len = sizeof(fields);
+  size_t i = 0;
+  while (i < RECORD_VALUES_COUNT) {
+    if ((fields & RECORD_VALUES[i].fields) != 0) {
+      len += RECORD_VALUES[i].size;
+    }
+    ++i;
+  }
+  if ((c->len + len) > c->capacity) {
+    size_t capacity = (c->capacity == 0) ? 4096 : (c->capacity * 2);
+    while ((c->len + len) > capacity) {
+      capacity *= 2;
+    }
+    unsigned char *const records = realloc(c->records, capacity);
+    if (records == 0) {
+      return -1;
+    }
+    c->records = records;
+    c->capacity = capacity;
+  }
+  unsigned char *r = &c->records[c->len];
+  memcpy(r, &fields, sizeof(fields));
+  r += sizeof(fields);
+  i = 0;
+  while (i < RECORD_VALUES_COUNT) {
+    if ((fields & RECORD_VALUES[i].fields) != 0) {
+      memcpy(r, &((const unsigned char *)data)[RECORD_VALUES[i].offset],
+             RECORD_VALUES[i].size);
+      r += RECORD_VALUES[i].size;
+    }
+    ++i;
+  }
+  c->len += len;
+  ++c->count;
+  return 0;
+}
+
+/* reads the record at r into the fields of data that it set, returns the end
+ * of the record */
+static const unsigned char *record_read(const unsigned char *r,
+                                        struct nmea_data *const data,
+                                        nmea_field_bitmap_t *const fields) {
+  memcpy(fields, r, sizeof(*fields));
+  r += sizeof(*fields);
+  size_t i = 0;
+  while (i < RECORD_VALUES_COUNT) {
+    if ((*fields & RECORD_VALUES[i].fields) != 0) {
+      memcpy(&((unsigned char *)data)[RECORD_VALUES[i].offset], r,
+             RECORD_VALUES[i].size);
+      r += RECORD_VALUES[i].size;
+    }
+    ++i;
+  }
+  return r;
+}
+
+/* parses a chunk in place in the mapped file */
+static void chunk_parse(const struct nmea_mmap *const m,
+                        struct chunk *const c) {
+  struct nmea n;
+  nmea_init(&n);
+  unsigned char dated = 0;
+  c->undated = 0;
+  size_t i = c->start;
+  while (i < c->end) {
+    i += nmea_parse_buf(&n, &m->buf[i], c->end - i);
+    const nmea_field_bitmap_t fields = n.state.received;
+    if (fields != 0) {
+      nmea_decode(&n, fields);
+      n.state.received = 0;
+      if ((dated == 0) && ((fields & NMEA_FIELD_DATE_MASK) != 0)) {
+        dated = 1;
+        c->undated = c->count;
+      }
+      if (chunk_record(c, &n.data, fields) != 0) {
+        c->rc = -1;
+        return;
+      }
+    }
+  }
+  if (dated == 0) {
+    c->undated = c->count;
+  }
+}
+
+/* takes the next chunk of the file and parses it, until the whole file has been
+ * taken */
+static void *parallel_thread(void *const arg) {
+  struct parallel *const p = arg;
+  pthread_mutex_lock(&p->lock);
+  while (1) {
+    while ((p->stop == 0) && (p->next < p->m.len) &&
+           ((p->claimed - p->merged) >= p->window)) {
+      pthread_cond_wait(&p->cond, &p->lock);
+    }
+    if ((p->stop != 0) || (p->next >= p->m.len)) {
+      break;
+    }
+    struct chunk *const c = &p->chunks[p->claimed % p->window];
+    c->start = p->next;
+    c->end = find_boundary(&p->m, c->start + p->chunk_len);
+    p->next = c->end;
+    ++p->claimed;
+    pthread_mutex_unlock(&p->lock);
+
+    chunk_parse(&p->m, c);
+
+    pthread_mutex_lock(&p->lock);
+    c->done = 1;
+    pthread_cond_broadcast(&p->cond);
+  }
+  pthread_mutex_unlock(&p->lock);
+  return 0;
+}
+
+/* applies the records of a chunk to the data of the chunks before it */
+static void chunk_merge(const struct chunk *const c,
+                        struct nmea_data *const data, nmea_parallel_fn fn,
+                        void *const ctx) {
+  const unsigned char *r = c->records;
+  size_t i = 0;
+  while (i < c->count) {
+    struct nmea_data record;
+    nmea_field_bitmap_t fields;
+    r = record_read(r, &record, &fields);
+    if ((i < c->undated) && ((fields & NMEA_FIELD_TIME_MASK) != 0)) {
+      /* the chunk's parser has no date yet, so carry the last one over */
+      record.time = ((data->time / SECONDS_IN_DAY) * SECONDS_IN_DAY) +
+                    (record.time % SECONDS_IN_DAY);
+    }
+    nmea_data_merge(data, &record, fields);
+    fn(data, fields, ctx);
+    ++i;
+  }
+}
+
+int nmea_parse_file_parallel(const char *const path, unsigned int threads,
+                             nmea_parallel_fn fn, void *const ctx) {
+  if (threads == 0) {
+    const long int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = (cpus > 0) ? cpus : 1;
+  }
+  struct parallel p;
+  memset(&p, 0, sizeof(p));
+  if (nmea_mmap_open(&p.m, path) != 0) {
+    return -1;
+  }
+  p.window = (size_t)threads * CHUNKS_PER_THREAD;
+  p.chunk_len = (p.m.len + threads - 1) / threads;
+  if (p.chunk_len > NMEA_PARALLEL_CHUNK_BYTES) {
+    p.chunk_len = NMEA_PARALLEL_CHUNK_BYTES;
+  }
+  p.chunks = calloc(p.window, sizeof(p.chunks[0]));
+  pthread_t *const ids = malloc(threads * sizeof(ids[0]));
+  if ((p.chunks == 0) || (ids == 0)) {
+    free(p.chunks);
+    free(ids);
+    nmea_mmap_close(&p.m);
+    return -1;
+  }
+  pthread_mutex_init(&p.lock, 0);
+  pthread_cond_init(&p.cond, 0);
+
+  unsigned int started = 0;
+  while (started < threads) {
+    if (pthread_create(&ids[started], 0, &parallel_thread, &p) != 0) {
+      break;
+    }
+    ++started;
+  }
+
+  int rc = ((started == 0) && (p.m.len != 0)) ? -1 : 0;
+  struct nmea_data data;
+  memset(&data, 0, sizeof(data));
+  size_t i = 0;
+  pthread_mutex_lock(&p.lock);
+  while (started != 0) {
+    struct chunk *const c = &p.chunks[i % p.window];
+    while (((i >= p.claimed) && (p.next < p.m.len) && (p.stop == 0)) ||
+           ((i < p.claimed) && (c->done == 0))) {
+      pthread_cond_wait(&p.cond, &p.lock);
+    }
+    if (i >= p.claimed) {
+      break;
+    }
+    pthread_mutex_unlock(&p.lock);
+
+    if (c->rc != 0) {
+      rc = -1;
+    }
+    if (rc == 0) {
+      chunk_merge(c, &data, fn, ctx);
+    }
+
+    pthread_mutex_lock(&p.lock);
+    c->len = 0;
+    c->count = 0;
+    c->rc = 0;
+    c->done = 0;
+    ++p.merged;
+    if (rc != 0) {
+      p.stop = 1;
+    }
+    pthread_cond_broadcast(&p.cond);
+    ++i;
+  }
+  pthread_mutex_unlock(&p.lock);
+
+  while (started != 0) {
+    --started;
+    pthread_join(ids[started], 0);
+  }
+  i = 0;
+  while (i < p.window) {
+    free(p.chunks[i].records);
+    ++i;
+  }
+  pthread_cond_destroy(&p.cond);
+  pthread_mutex_destroy(&p.lock);
+  free(p.chunks);
+  free(ids);
+  nmea_mmap_close(&p.m);
+  return rc;
+}
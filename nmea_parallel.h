@@ -0,0 +1,55 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NMEA_PARALLEL_H
+#define NMEA_PARALLEL_H
+
+#include "nmea.h"
+
+/* the most bytes of the file parsed as one chunk */
+#define NMEA_PARALLEL_CHUNK_BYTES (1ul << 22)
+
+/*
+ * Called in file order for each sentence that sets fields. data holds every
+ * field received so far, as if the file had been parsed by a single parser, and
+ * fields holds the fields that the sentence set.
+ */
+typedef void (*nmea_parallel_fn)(const struct nmea_data *const data,
+                                 const nmea_field_bitmap_t fields,
+                                 void *const ctx);
+
+/*
+ * Parses the file at path in chunks on threads threads in parallel, 0 uses a
+ * thread per online CPU. The file is mapped into memory and parsed in place,
+ * in chunks of the file's size over threads, or NMEA_PARALLEL_CHUNK_BYTES if
+ * that is smaller. The chunks are split at the start of sentences, but never
+ * before the second or later sentence of a GSV set. Each chunk is parsed by its
+ * own parser, and the results are passed to fn, on the calling thread, as each
+ * chunk completes in file order.
+ *
+ * A chunk's results hold only the values that each sentence set, and at most
+ * twice threads chunks are parsed ahead of those passed to fn, so memory use is
+ * bounded by the chunk size rather than the file's.
+ *
+ * Sentences that set a time before the first date in their chunk take the date
+ * of the sentences before them, as they would with a single parser.
+ *
+ * Returns 0 on success or -1 if the file cannot be read, or memory or threads
+ * cannot be allocated.
+ */
+int nmea_parse_file_parallel(const char *const path, unsigned int threads,
+                             nmea_parallel_fn fn, void *const ctx);
+
+#endif
@@ -0,0 +1,116 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nmea_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int nmea_pool_init(struct nmea_pool *const p, const size_t size) {
+  memset(p, 0, sizeof(*p));
+  p->parsers = malloc(size * sizeof(p->parsers[0]));
+  p->latitude = calloc(size, sizeof(p->latitude[0]));
+  p->longitude = calloc(size, sizeof(p->longitude[0]));
+  p->time = calloc(size, sizeof(p->time[0]));
+  p->altitude = calloc(size, sizeof(p->altitude[0]));
+  p->speed = calloc(size, sizeof(p->speed[0]));
+  p->true_track = calloc(size, sizeof(p->true_track[0]));
+  p->fix_quality = calloc(size, sizeof(p->fix_quality[0]));
+  p->satellites_tracked = calloc(size, sizeof(p->satellites_tracked[0]));
+  p->received = calloc(size, sizeof(p->received[0]));
+  if ((p->parsers == 0) || (p->latitude == 0) || (p->longitude == 0) ||
+      (p->time == 0) || (p->altitude == 0) || (p->speed == 0) ||
+      (p->true_track == 0) || (p->fix_quality == 0) ||
+      (p->satellites_tracked == 0) || (p->received == 0)) {
+    nmea_pool_free(p);
+    return -1;
+  }
+  p->size = size;
+  size_t i = 0;
+  while (i < size) {
+    nmea_init(&p->parsers[i]);
+    ++i;
+  }
+  return 0;
+}
+
+void nmea_pool_free(struct nmea_pool *const p) {
+  free(p->parsers);
+  free(p->latitude);
+  free(p->longitude);
+  free(p->time);
+  free(p->altitude);
+  free(p->speed);
+  free(p->true_track);
+  free(p->fix_quality);
+  free(p->satellites_tracked);
+  free(p->received);
+  memset(p, 0, sizeof(*p));
+}
+
+/* copies the fields that the last sentence set into the stream's columns */
+static void pool_update(struct nmea_pool *const p, const size_t stream) {
+  struct nmea *const n = &p->parsers[stream];
+  const nmea_field_bitmap_t received = n->state.received & NMEA_POOL_FIELDS;
+  if (received == 0) {
+    return;
+  }
+  nmea_decode(n, received);
+  /* the parsers are private to the pool, so their flags are consumed here */
+  n->state.received &= ~received;
+  p->received[stream] |= received;
+  if ((received & NMEA_FIELD_LATITUDE_MASK) != 0) {
+    p->latitude[stream] = n->data.latitude;
+  }
+  if ((received & NMEA_FIELD_LONGITUDE_MASK) != 0) {
+    p->longitude[stream] = n->data.longitude;
+  }
+  if ((received & (NMEA_FIELD_TIME_MASK | NMEA_FIELD_DATE_MASK)) != 0) {
+    p->time[stream] = n->data.time;
+  }
+  if ((received & NMEA_FIELD_ALTITUDE_MASK) != 0) {
+    p->altitude[stream] = n->data.altitude;
+  }
+  if ((received & NMEA_FIELD_SPEED_MASK) != 0) {
+    p->speed[stream] = n->data.speed;
+  }
+  if ((received & NMEA_FIELD_TRUE_TRACK_MASK) != 0) {
+    p->true_track[stream] = n->data.true_track;
+  }
+  if ((received & NMEA_FIELD_FIX_QUALITY_MASK) != 0) {
+    p->fix_quality[stream] = n->data.fix_quality;
+  }
+  if ((received & NMEA_FIELD_SATELLITES_TRACKED_MASK) != 0) {
+    p->satellites_tracked[stream] = n->data.satellites_tracked;
+  }
+}
+
+void nmea_pool_parse(struct nmea_pool *const p,
+                     const struct nmea_pool_input *const inputs,
+                     const size_t count) {
+  size_t i = 0;
+  while (i < count) {
+    const struct nmea_pool_input *const in = &inputs[i];
+    if (in->stream < p->size) {
+      struct nmea *const n = &p->parsers[in->stream];
+      size_t used = 0;
+      while (used < in->len) {
+        used += nmea_parse_buf(n, &in->buf[used], in->len - used);
+        pool_update(p, in->stream);
+      }
+    }
+    ++i;
+  }
+}
@@ -0,0 +1,75 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NMEA_POOL_H
+#define NMEA_POOL_H
+
+#include "nmea.h"
+
+/* the fields copied into the columns of a pool */
+static const nmea_field_bitmap_t NMEA_POOL_FIELDS =
+    NMEA_FIELD_LATITUDE_MASK | NMEA_FIELD_LONGITUDE_MASK |
+    NMEA_FIELD_ALTITUDE_MASK | NMEA_FIELD_TIME_MASK | NMEA_FIELD_DATE_MASK |
+    NMEA_FIELD_SPEED_MASK | NMEA_FIELD_TRUE_TRACK_MASK |
+    NMEA_FIELD_FIX_QUALITY_MASK | NMEA_FIELD_SATELLITES_TRACKED_MASK;
+
+/*
+ * A pool of parsers, one per stream, held in a single array. The fields in
+ * NMEA_POOL_FIELDS are copied into a column per field as each sentence
+ * completes, so the latest values of every stream can be read in order
+ * without touching the parsers.
+ */
+struct nmea_pool {
+  struct nmea *parsers;
+  size_t size;
+  long long int *latitude;
+  long long int *longitude;
+  long long int *time;
+  long int *altitude;
+  unsigned long int *speed;
+  long int *true_track;
+  unsigned char *fix_quality;
+  unsigned short int *satellites_tracked;
+  /* the fields of each stream updated since the flags were last cleared */
+  nmea_field_bitmap_t *received;
+};
+
+/* a buffer of input for a single stream */
+struct nmea_pool_input {
+  size_t stream;
+  const char *buf;
+  size_t len;
+};
+
+/*
+ * Allocates and initialises a pool of size parsers, returns 0 on success or -1
+ * if the allocation fails.
+ */
+int nmea_pool_init(struct nmea_pool *const p, const size_t size);
+
+/*
+ * Frees the memory allocated by nmea_pool_init.
+ */
+void nmea_pool_free(struct nmea_pool *const p);
+
+/*
+ * Parses each of the count inputs with the parser of its stream in turn,
+ * updating the columns. Inputs with an out of range stream are skipped.
+ */
+void nmea_pool_parse(struct nmea_pool *const p,
+                     const struct nmea_pool_input *const inputs,
+                     const size_t count);
+
+#endif
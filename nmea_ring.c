@@ -0,0 +1,118 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nmea_ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* the indices count bytes from the start and wrap at SIZE_MAX, the mask gives
+ * the position in the buffer */
+
+int nmea_ring_init(struct nmea_ring *const r, const size_t size) {
+  memset(r, 0, sizeof(*r));
+  if ((size == 0) || ((size & (size - 1)) != 0)) {
+    return -1;
+  }
+  r->buf = malloc(size);
+  if (r->buf == 0) {
+    return -1;
+  }
+  r->mask = size - 1;
+  atomic_init(&r->head, 0);
+  atomic_init(&r->tail, 0);
+  return 0;
+}
+
+void nmea_ring_free(struct nmea_ring *const r) {
+  free(r->buf);
+  r->buf = 0;
+}
+
+/* copies len bytes into the ring at index i, wrapping at the end */
+static void ring_write(struct nmea_ring *const r, const size_t i,
+                       const char *const buf, const size_t len) {
+  const size_t pos = i & r->mask;
+  const size_t first = r->mask + 1 - pos;
+  if (len <= first) {
+    memcpy(&r->buf[pos], buf, len);
+  } else {
+    memcpy(&r->buf[pos], buf, first);
+    memcpy(r->buf, &buf[first], len - first);
+  }
+}
+
+static void ring_read(const struct nmea_ring *const r, const size_t i,
+                      char *const buf, const size_t len) {
+  const size_t pos = i & r->mask;
+  const size_t first = r->mask + 1 - pos;
+  if (len <= first) {
+    memcpy(buf, &r->buf[pos], len);
+  } else {
+    memcpy(buf, &r->buf[pos], first);
+    memcpy(&buf[first], r->buf, len - first);
+  }
+}
+
+size_t nmea_ring_push(struct nmea_ring *const r, const char *const buf,
+                      const size_t len) {
+  const size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+  size_t space = r->mask + 1 - (head - r->tail_cache);
+  if (space < len) {
+    /* only look at the consumer's index when the cached one is not enough */
+    r->tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire);
+    space = r->mask + 1 - (head - r->tail_cache);
+  }
+  const size_t n = (len < space) ? len : space;
+  ring_write(r, head, buf, n);
+  atomic_store_explicit(&r->head, head + n, memory_order_release);
+  return n;
+}
+
+/* the number of bytes available to the consumer, refreshing the cached
+ * producer index if less than want are */
+static size_t ring_available(struct nmea_ring *const r, const size_t tail,
+                             const size_t want) {
+  size_t available = r->head_cache - tail;
+  if (available < want) {
+    r->head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+    available = r->head_cache - tail;
+  }
+  return available;
+}
+
+size_t nmea_ring_pop(struct nmea_ring *const r, char *const buf,
+                     const size_t len) {
+  const size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  const size_t available = ring_available(r, tail, len);
+  const size_t n = (len < available) ? len : available;
+  ring_read(r, tail, buf, n);
+  atomic_store_explicit(&r->tail, tail + n, memory_order_release);
+  return n;
+}
+
+size_t nmea_ring_peek(struct nmea_ring *const r, const char **const p) {
+  const size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  const size_t pos = tail & r->mask;
+  const size_t first = r->mask + 1 - pos;
+  const size_t available = ring_available(r, tail, first);
+  *p = &r->buf[pos];
+  return (available < first) ? available : first;
+}
+
+void nmea_ring_release(struct nmea_ring *const r, const size_t len) {
+  const size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  atomic_store_explicit(&r->tail, tail + len, memory_order_release);
+}
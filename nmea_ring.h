@@ -0,0 +1,79 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NMEA_RING_H
+#define NMEA_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define NMEA_RING_CACHE_LINE (64)
+
+/*
+ * A lock free byte ring buffer for a single producer thread and a single
+ * consumer thread. Each thread's index is on its own cache line along with its
+ * cached copy of the other thread's index, so the threads only share a line
+ * when one runs out of space or data.
+ */
+struct nmea_ring {
+  char *buf;
+  size_t mask;
+  /* written by the producer */
+  _Alignas(NMEA_RING_CACHE_LINE) atomic_size_t head;
+  size_t tail_cache;
+  /* written by the consumer */
+  _Alignas(NMEA_RING_CACHE_LINE) atomic_size_t tail;
+  size_t head_cache;
+};
+
+/*
+ * Allocates a ring of size bytes, which must be a power of 2. Returns 0 on
+ * success or -1 if size is not a power of 2 or the allocation fails.
+ */
+int nmea_ring_init(struct nmea_ring *const r, const size_t size);
+
+/*
+ * Frees the memory allocated by nmea_ring_init.
+ */
+void nmea_ring_free(struct nmea_ring *const r);
+
+/*
+ * Producer only. Copies as many of the len bytes in buf into the ring as fit,
+ * returns the number copied.
+ */
+size_t nmea_ring_push(struct nmea_ring *const r, const char *const buf,
+                      const size_t len);
+
+/*
+ * Consumer only. Copies up to len bytes out of the ring into buf, returns the
+ * number copied.
+ */
+size_t nmea_ring_pop(struct nmea_ring *const r, char *const buf,
+                     const size_t len);
+
+/*
+ * Consumer only. Points p at the oldest bytes in the ring without copying them
+ * and returns how many there are before the end of the buffer wraps, which can
+ * be passed straight to nmea_parse_buf. Call nmea_ring_release with the number
+ * used.
+ */
+size_t nmea_ring_peek(struct nmea_ring *const r, const char **const p);
+
+/*
+ * Consumer only. Frees the first len bytes returned by nmea_ring_peek.
+ */
+void nmea_ring_release(struct nmea_ring *const r, const size_t len);
+
+#endif
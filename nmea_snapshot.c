@@ -0,0 +1,84 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nmea_snapshot.h"
+
+#include <string.h>
+
+/* the record is copied through relaxed atomic words rather than memcpy so that
+ * a reader racing a publish is well defined, the fences order the words against
+ * the sequence number */
+
+void nmea_snapshot_init(struct nmea_snapshot *const s) {
+  atomic_init(&s->seq, 0);
+  size_t i = 0;
+  while (i < NMEA_SNAPSHOT_WORDS) {
+    atomic_init(&s->words[i], 0);
+    ++i;
+  }
+}
+
+void nmea_snapshot_publish(struct nmea_snapshot *const s,
+                           const struct nmea_data *const data,
+                           const nmea_field_bitmap_t fields) {
+  unsigned long int words[NMEA_SNAPSHOT_WORDS];
+  struct nmea_snapshot_record r;
+  memset(&r, 0, sizeof(r));
+  r.data = *data;
+  r.fields = fields;
+  memcpy(words, &r, sizeof(r));
+
+  const unsigned long int seq =
+      atomic_load_explicit(&s->seq, memory_order_relaxed);
+  atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+  /* the odd sequence number must be visible before any of the words change */
+  atomic_thread_fence(memory_order_release);
+  size_t i = 0;
+  while (i < NMEA_SNAPSHOT_WORDS) {
+    atomic_store_explicit(&s->words[i], words[i], memory_order_relaxed);
+    ++i;
+  }
+  atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+}
+
+unsigned long int nmea_snapshot_read(const struct nmea_snapshot *const s,
+                                     struct nmea_snapshot_record *const r) {
+  unsigned long int words[NMEA_SNAPSHOT_WORDS];
+  unsigned long int seq;
+  while (1) {
+    seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+    if ((seq & 1) == 0) {
+      size_t i = 0;
+      while (i < NMEA_SNAPSHOT_WORDS) {
+        words[i] = atomic_load_explicit(&s->words[i], memory_order_relaxed);
+        ++i;
+      }
+      /* the words must be read before the sequence number is checked again */
+      atomic_thread_fence(memory_order_acquire);
+      if (atomic_load_explicit(&s->seq, memory_order_relaxed) == seq) {
+        break;
+      }
+    }
+  }
+  memcpy(r, words, sizeof(*r));
+  return seq / 2;
+}
+
+void nmea_snapshot_callback(const struct nmea_data *const data,
+                            const enum nmea_sentences sentence,
+                            const nmea_field_bitmap_t fields, void *const ctx) {
+  (void)sentence;
+  nmea_snapshot_publish(ctx, data, fields);
+}
@@ -0,0 +1,84 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NMEA_SNAPSHOT_H
+#define NMEA_SNAPSHOT_H
+
+#include "nmea.h"
+
+#include <stdatomic.h>
+
+#define NMEA_SNAPSHOT_CACHE_LINE (64)
+
+/* the data and fields of the last sentence published */
+struct nmea_snapshot_record {
+  struct nmea_data data;
+  nmea_field_bitmap_t fields;
+};
+
+#define NMEA_SNAPSHOT_WORDS                                                    \
+  ((sizeof(struct nmea_snapshot_record) + sizeof(unsigned long int) - 1) /     \
+   sizeof(unsigned long int))
+
+/*
+ * Publishes complete copies of the parser's data from the parser thread to any
+ * number of reader threads with a sequence lock. The parser never waits for the
+ * readers, and a reader only ever sees the data as it was at the end of a
+ * sentence, never a mix of two sentences such as a new latitude with an old
+ * longitude. A reader that overlaps a publish copies again.
+ */
+struct nmea_snapshot {
+  /* odd while a publish is in progress, incremented twice per publish */
+  _Alignas(NMEA_SNAPSHOT_CACHE_LINE) atomic_ulong seq;
+  /* the record, copied a word at a time */
+  atomic_ulong words[NMEA_SNAPSHOT_WORDS];
+};
+
+/*
+ * Initialises the snapshot with zeroed data that has not been published.
+ */
+void nmea_snapshot_init(struct nmea_snapshot *const s);
+
+/*
+ * Publishes a copy of data and the fields set in it. Must only be called from
+ * one thread at a time, usually the parser's.
+ */
+void nmea_snapshot_publish(struct nmea_snapshot *const s,
+                           const struct nmea_data *const data,
+                           const nmea_field_bitmap_t fields);
+
+/*
+ * Copies the last data published into r, can be called from any thread.
+ * Returns the number of publishes so far, which can be compared with the
+ * previous value to tell if anything new has been published.
+ */
+unsigned long int nmea_snapshot_read(const struct nmea_snapshot *const s,
+                                     struct nmea_snapshot_record *const r);
+
+/*
+ * A callback that publishes each sentence as it completes, register it with the
+ * snapshot as its context.
+ *
+ * for example:
+ *   const struct nmea_callback callbacks[] = {
+ *       {&nmea_snapshot_callback, ~(nmea_sentence_bitmap_t)0,
+ *        ~(nmea_field_bitmap_t)0, &s}};
+ *   nmea_set_callbacks(&n, callbacks, 1);
+ */
+void nmea_snapshot_callback(const struct nmea_data *const data,
+                            const enum nmea_sentences sentence,
+                            const nmea_field_bitmap_t fields, void *const ctx);
+
+#endif
@@ -0,0 +1,292 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../nmea_encode.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_ITERATIONS (20000)
+
+static unsigned long long int test_state = 1;
+
+static unsigned long long int test_rand(void) {
+  test_state = (test_state * 6364136223846793005ull) + 1442695040888963407ull;
+  return test_state >> 11;
+}
+
+/* a random value in [-range, range] */
+static long long int test_rand_signed(const unsigned long long int range) {
+  const long long int v = (long long int)(test_rand() % (range + 1));
+  return ((test_rand() & 1) != 0) ? -v : v;
+}
+
+static unsigned long long int fxp_one(const enum nmea_fields field) {
+  return ((unsigned long long int)1) << NMEA_FXP_FRACTIONALS[field];
+}
+
+static void random_data(struct nmea_data *const d) {
+  memset(d, 0, sizeof(*d));
+  d->latitude = test_rand_signed(90 * fxp_one(NMEA_FIELD_LATITUDE));
+  d->longitude = test_rand_signed(180 * fxp_one(NMEA_FIELD_LONGITUDE));
+  /* 2000-01-01 to 2099-12-31, within the parser's default century */
+  d->time = 946684800 + (long long int)(test_rand() % (100ull * 365 * 86400));
+  d->hdop = test_rand() % (100 * fxp_one(NMEA_FIELD_HDOP));
+  d->pdop = test_rand() % (100 * fxp_one(NMEA_FIELD_PDOP));
+  d->vdop = test_rand() % (100 * fxp_one(NMEA_FIELD_VDOP));
+  d->speed = test_rand() % (1000 * fxp_one(NMEA_FIELD_SPEED));
+  d->true_track = test_rand() % (360 * fxp_one(NMEA_FIELD_TRUE_TRACK));
+  d->magnetic_track = test_rand() % (360 * fxp_one(NMEA_FIELD_MAGNETIC_TRACK));
+  d->magnetic_variation =
+      test_rand_signed(180 * fxp_one(NMEA_FIELD_MAGNETIC_VARIATION));
+  d->altitude = test_rand_signed(10000 * fxp_one(NMEA_FIELD_ALTITUDE));
+  d->geoid_height = test_rand_signed(200 * fxp_one(NMEA_FIELD_GEOID_HEIGHT));
+  d->fix_quality = test_rand() % (NMEA_FIX_SIMULATION_MODE + 1);
+  d->fix_3d = NMEA_FIX_NONE + (test_rand() % 3);
+  d->gll_active = test_rand() & 1;
+  d->rmc_active = test_rand() & 1;
+  d->talker = NMEA_TALKER_GP + (test_rand() % NMEA_TALKER_GN);
+  d->satellites_tracked = test_rand() % 25;
+  d->satellites_in_view = test_rand() % (NMEA_MAX_SATS + 1);
+  unsigned int i = 0;
+  while (i < d->satellites_in_view) {
+    d->sats[i].prn = 1 + (test_rand() % 99);
+    d->sats[i].elevation = test_rand() % 91;
+    d->sats[i].azimuth = test_rand() % 360;
+    d->sats[i].snr = test_rand() % 100;
+    ++i;
+  }
+  /* the parser packs the prns tracked from the start */
+  const unsigned int prns = test_rand() % (NMEA_MAX_PRNS_TRACKED + 1);
+  i = 0;
+  while (i < prns) {
+    d->prns_tracked[i] = 1 + (test_rand() % 99);
+    ++i;
+  }
+}
+
+/* encodes a sentence of d, parses it and checks that it sets fields, then
+ * encodes the parsed data again and checks that it is the same */
+static int round_trip(const struct nmea_data *const d,
+                      const enum nmea_sentences sentence,
+                      const nmea_field_bitmap_t fields,
+                      struct nmea_data *const parsed) {
+  char buf[512];
+  const size_t len = nmea_encode(d, sentence, buf, sizeof(buf));
+  if (len == 0) {
+    printf("ERR: sentence %u not encoded\n", (unsigned int)sentence);
+    return -1;
+  }
+  struct nmea n;
+  nmea_init(&n);
+  nmea_field_bitmap_t received = 0;
+  size_t i = 0;
+  while (i < len) {
+    i += nmea_parse_buf(&n, &buf[i], len - i);
+    received |= n.state.received;
+    nmea_decode(&n, ~(nmea_field_bitmap_t)0);
+  }
+  if ((received & fields) != fields) {
+    printf("ERR: fields not received from: %.*s", (int)len, buf);
+    return -1;
+  }
+  *parsed = n.data;
+  char again[512];
+  const size_t again_len = nmea_encode(parsed, sentence, again, sizeof(again));
+  if ((again_len != len) || (memcmp(buf, again, len) != 0)) {
+    printf("ERR: sentence changed by parsing:\n%.*s%.*s", (int)len, buf,
+           (int)again_len, again);
+    return -1;
+  }
+  return 0;
+}
+
+/* 1 if a and b are within tolerance */
+static int near(const long long int a, const long long int b,
+                const unsigned long long int tolerance) {
+  const unsigned long long int diff = (a > b)
+                                          ? ((unsigned long long int)a - b)
+                                          : ((unsigned long long int)b - a);
+  return (diff <= tolerance) ? 1 : 0;
+}
+
+/* the last decimal place written of a field in its Q format, rounded up */
+static unsigned long long int digit(const enum nmea_fields field,
+                                    const unsigned long long int pow10) {
+  return (fxp_one(field) + pow10 - 1) / pow10;
+}
+
+/* test that every sentence round trips through the parser with its fields
+ * within the last decimal place written */
+int test_round_trip(void) {
+  const unsigned long long int angle = 60ull * 1000000;
+  unsigned int iteration = 0;
+  while (iteration < TEST_ITERATIONS) {
+    struct nmea_data d;
+    random_data(&d);
+    struct nmea_data p;
+
+    if (round_trip(&d, NMEA_SENTENCE_GGA,
+                   NMEA_FIELD_TIME_MASK | NMEA_FIELD_LATITUDE_MASK |
+                       NMEA_FIELD_LONGITUDE_MASK | NMEA_FIELD_ALTITUDE_MASK,
+                   &p) != 0) {
+      return -1;
+    }
+    if (((p.time % 86400) != (d.time % 86400)) ||
+        (near(p.latitude, d.latitude, digit(NMEA_FIELD_LATITUDE, angle)) ==
+         0) ||
+        (near(p.longitude, d.longitude, digit(NMEA_FIELD_LONGITUDE, angle)) ==
+         0) ||
+        (near(p.altitude, d.altitude, digit(NMEA_FIELD_ALTITUDE, 100)) == 0) ||
+        (near(p.geoid_height, d.geoid_height,
+              digit(NMEA_FIELD_GEOID_HEIGHT, 100)) == 0) ||
+        (near(p.hdop, d.hdop, digit(NMEA_FIELD_HDOP, 1000)) == 0) ||
+        (p.fix_quality != d.fix_quality) ||
+        (p.satellites_tracked != d.satellites_tracked) ||
+        (p.talker != d.talker)) {
+      printf("ERR: GGA fields incorrect\n");
+      return -1;
+    }
+
+    if (round_trip(&d, NMEA_SENTENCE_RMC,
+                   NMEA_FIELD_DATE_MASK | NMEA_FIELD_SPEED_MASK, &p) != 0) {
+      return -1;
+    }
+    if ((p.time != d.time) || (p.rmc_active != d.rmc_active) ||
+        (near(p.speed, d.speed, digit(NMEA_FIELD_SPEED, 1000)) == 0) ||
+        (near(p.true_track, d.true_track,
+              digit(NMEA_FIELD_TRUE_TRACK, 1000)) == 0) ||
+        (near(p.magnetic_variation, d.magnetic_variation,
+              digit(NMEA_FIELD_MAGNETIC_VARIATION, 1000)) == 0)) {
+      printf("ERR: RMC fields incorrect\n");
+      return -1;
+    }
+
+    if (round_trip(&d, NMEA_SENTENCE_GLL, NMEA_FIELD_LATITUDE_MASK, &p) !=
+        0) {
+      return -1;
+    }
+    if (p.gll_active != d.gll_active) {
+      printf("ERR: GLL fields incorrect\n");
+      return -1;
+    }
+
+    if (round_trip(&d, NMEA_SENTENCE_VTG, NMEA_FIELD_MAGNETIC_TRACK_MASK,
+                   &p) != 0) {
+      return -1;
+    }
+    if (near(p.magnetic_track, d.magnetic_track,
+             digit(NMEA_FIELD_MAGNETIC_TRACK, 1000)) == 0) {
+      printf("ERR: VTG fields incorrect\n");
+      return -1;
+    }
+
+    if (round_trip(&d, NMEA_SENTENCE_GSA, NMEA_FIELD_PDOP_MASK, &p) != 0) {
+      return -1;
+    }
+    if ((p.fix_3d != d.fix_3d) ||
+        (memcmp(p.prns_tracked, d.prns_tracked, sizeof(p.prns_tracked)) !=
+         0) ||
+        (near(p.vdop, d.vdop, digit(NMEA_FIELD_VDOP, 1000)) == 0)) {
+      printf("ERR: GSA fields incorrect\n");
+      return -1;
+    }
+
+    if (round_trip(&d, NMEA_SENTENCE_GSV, NMEA_FIELD_SATELLITES_IN_VIEW_MASK,
+                   &p) != 0) {
+      return -1;
+    }
+    if ((p.satellites_in_view != d.satellites_in_view) ||
+        (memcmp(p.sats, d.sats,
+                d.satellites_in_view * sizeof(struct nmea_sat)) != 0)) {
+      printf("ERR: GSV fields incorrect\n");
+      return -1;
+    }
+    ++iteration;
+  }
+  return 0;
+}
+
+/* test the text of a sentence parsed from a receiver, including its checksum,
+ * and values that round to 0 or to the next degree */
+int test_format(void) {
+  static const char gga[] =
+      "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,"
+      "*74\r\n";
+  struct nmea n;
+  nmea_init(&n);
+  nmea_parse_buf(&n, gga, sizeof(gga) - 1);
+  nmea_decode(&n, ~(nmea_field_bitmap_t)0);
+  static const char body[] = "GPGGA,175456.00,5104.344320,N,00147.298140,W,1,"
+                             "03,2.880,61.80,M,47.50,M,,";
+  char expected[128];
+  const int expected_len =
+      snprintf(expected, sizeof(expected), "$%s*%02X\r\n", body,
+               nmea_checksum(body, sizeof(body) - 1));
+  char buf[128];
+  size_t len = nmea_encode(&n.data, NMEA_SENTENCE_GGA, buf, sizeof(buf));
+  if ((len != (size_t)expected_len) || (memcmp(buf, expected, len) != 0)) {
+    printf("ERR: GGA text incorrect:\n%.*s%s", (int)len, buf, expected);
+    return -1;
+  }
+  if (nmea_encode(&n.data, NMEA_SENTENCE_GGA, buf, len - 1) != 0) {
+    printf("ERR: encoded into a buffer that is too small\n");
+    return -1;
+  }
+
+  struct nmea_data d;
+  memset(&d, 0, sizeof(d));
+  d.talker = NMEA_TALKER_GN;
+  /* just under 1 degree south and west, which round to the next degree */
+  d.latitude = -(long long int)fxp_one(NMEA_FIELD_LATITUDE) + 1;
+  d.longitude = -(long long int)fxp_one(NMEA_FIELD_LONGITUDE) + 1;
+  /* rounds to 0, which is written without its sign */
+  d.altitude = -1;
+  d.magnetic_variation = -1;
+  d.time = -1;
+  len = nmea_encode(&d, NMEA_SENTENCE_RMC, buf, sizeof(buf));
+  if ((len == 0) ||
+      (strncmp(buf, "$GNRMC,235959.00,V,0100.000000,S,00100.000000,W,", 48) !=
+       0) ||
+      (strstr(buf, ",311269,0.000,E,N*") == 0)) {
+    printf("ERR: RMC text incorrect: %.*s", (int)len, buf);
+    return -1;
+  }
+  len = nmea_encode(&d, NMEA_SENTENCE_GGA, buf, sizeof(buf));
+  if ((len == 0) || (strstr(buf, ",0.00,M,0.00,M,,*") == 0)) {
+    printf("ERR: GGA zero text incorrect: %.*s", (int)len, buf);
+    return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+
+  int rc;
+
+  rc = test_format();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_round_trip();
+  if (rc != 0) {
+    return rc;
+  }
+
+  return 0;
+}
@@ -0,0 +1,279 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../nmea_epoch.h"
+#include "../nmea_float.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_EPOCHS (10)
+
+struct epochs {
+  struct nmea_epoch epoch[TEST_EPOCHS];
+  unsigned int count;
+};
+
+static void record(const struct nmea_epoch *const epoch, void *const ctx) {
+  struct epochs *const e = ctx;
+  if (e->count < TEST_EPOCHS) {
+    e->epoch[e->count] = *epoch;
+  }
+  ++e->count;
+}
+
+static void parse_string(struct nmea *const n, const char *s) {
+  while (*s) {
+    nmea_parse(n, *s);
+    ++s;
+  }
+}
+
+/* test that epochs are passed on once complete, when the next epoch starts, or
+ * when their deadline passes */
+int test_epoch(void) {
+  static const nmea_sentence_bitmap_t required =
+      NMEA_SENTENCE_RMC_MASK | NMEA_SENTENCE_GGA_MASK |
+      NMEA_SENTENCE_GSA_MASK | NMEA_SENTENCE_GSV_MASK;
+
+  struct nmea_epoch_assembler a;
+  struct epochs e;
+  e.count = 0;
+  nmea_epoch_init(&a, required, 100, &record, &e);
+
+  struct nmea n;
+  nmea_init(&n);
+  const struct nmea_callback callbacks[] = {{&nmea_epoch_callback,
+                                             ~(nmea_sentence_bitmap_t)0,
+                                             ~(nmea_field_bitmap_t)0, &a}};
+  nmea_set_callbacks(&n, callbacks, 1);
+
+  /* a complete epoch, the GSA arrives before any sentence with a time */
+  parse_string(
+      &n, "$GPGSA,A,2,18,16,23,,,,,,,,,,3.05,2.88,1.00*09\r\n"
+          "$GPRMC,175456.00,A,5104.34432,N,00147.29814,W,34.075,213.73,"
+          "080321,,,A*47\r\n"
+          "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+          "47.5,M,,*74\r\n"
+          "$GPGSV,2,1,08,05,02,020,,07,,,33,16,76,272,33,18,58,069,31*48\r\n");
+  if (e.count != 0) {
+    printf("ERR: incomplete epoch passed on\n");
+    return -1;
+  }
+  parse_string(
+      &n, "$GPGSV,2,2,08,20,,,24,23,28,121,20,26,,,31,27,46,274,32*7F\r\n");
+  const nmea_field_bitmap_t fields =
+      NMEA_FIELD_TIME_MASK | NMEA_FIELD_DATE_MASK | NMEA_FIELD_ALTITUDE_MASK |
+      NMEA_FIELD_PDOP_MASK | NMEA_FIELD_PRN_MASK | NMEA_FIELD_SPEED_MASK;
+  if ((e.count != 1) || (e.epoch[0].complete != 1) ||
+      (e.epoch[0].sentences != required) ||
+      ((e.epoch[0].fields & fields) != fields) ||
+      (e.epoch[0].data.time != 0x604664f0) ||
+      (e.epoch[0].data.satellites_tracked != 3) ||
+      (e.epoch[0].data.sats[7].prn != 27)) {
+    printf("ERR: complete epoch incorrect\n");
+    return -1;
+  }
+
+  /* an epoch without GSA or GSV ends when the next one starts */
+  parse_string(&n, "$GPRMC,175457.00,A,5104.34432,N,00147.29814,W,34.075,"
+                   "213.73,080321,,,A*46\r\n");
+  parse_string(&n, "$GPRMC,175458.00,A,5104.34432,N,00147.29814,W,34.075,"
+                   "213.73,080321,,,A*49\r\n");
+  if ((e.count != 2) || (e.epoch[1].complete != 0) ||
+      (e.epoch[1].sentences != NMEA_SENTENCE_RMC_MASK) ||
+      (e.epoch[1].data.time != 0x604664f1) ||
+      (e.epoch[1].data.altitude != 0)) {
+    printf("ERR: incomplete epoch incorrect\n");
+    return -1;
+  }
+
+  /* the open epoch is passed on once its deadline passes */
+  nmea_epoch_tick(&a, 99);
+  if (e.count != 2) {
+    printf("ERR: epoch passed on before its deadline\n");
+    return -1;
+  }
+  nmea_epoch_tick(&a, 100);
+  if ((e.count != 3) || (e.epoch[2].data.time != 0x604664f2)) {
+    printf("ERR: epoch not passed on at its deadline\n");
+    return -1;
+  }
+  nmea_epoch_flush(&a);
+  if (e.count != 3) {
+    printf("ERR: flushed an empty epoch\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+/* parses the sentence body between the '$' and the '*', adding the checksum */
+static void parse_body(struct nmea *const n, const char *const body) {
+  char s[128];
+  snprintf(s, sizeof(s), "$%s*%02X\r\n", body,
+           nmea_checksum(body, strlen(body)));
+  parse_string(n, s);
+}
+
+/* test that a receiver's whole output each second, with sentences after the
+ * required ones, is a single epoch per second */
+int test_epoch_cycle(void) {
+  static const nmea_sentence_bitmap_t requireds[] = {
+      NMEA_SENTENCE_RMC_MASK | NMEA_SENTENCE_GGA_MASK |
+          NMEA_SENTENCE_GSA_MASK | NMEA_SENTENCE_GSV_MASK,
+      NMEA_SENTENCE_RMC_MASK | NMEA_SENTENCE_GGA_MASK};
+  unsigned int r = 0;
+  while (r < (sizeof(requireds) / sizeof(requireds[0]))) {
+    struct nmea_epoch_assembler a;
+    struct epochs e;
+    e.count = 0;
+    nmea_epoch_init(&a, requireds[r], 100, &record, &e);
+    struct nmea n;
+    nmea_init(&n);
+    const struct nmea_callback callbacks[] = {{&nmea_epoch_callback,
+                                               ~(nmea_sentence_bitmap_t)0,
+                                               ~(nmea_field_bitmap_t)0, &a}};
+    nmea_set_callbacks(&n, callbacks, 1);
+
+    /* the order a NEO-6M outputs its sentences in */
+    unsigned int second = 0;
+    while (second < 3) {
+      char body[128];
+      snprintf(body, sizeof(body),
+               "GPRMC,17545%u.00,A,5104.34432,N,00147.29814,W,34.075,213.73,"
+               "080321,,,A",
+               second);
+      parse_body(&n, body);
+      parse_body(&n, "GPVTG,213.73,T,,M,34.075,N,63.107,K,A");
+      snprintf(body, sizeof(body),
+               "GPGGA,17545%u.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+               "47.5,M,,",
+               second);
+      parse_body(&n, body);
+      parse_body(&n, "GPGSA,A,2,18,16,23,,,,,,,,,,3.05,2.88,1.00");
+      parse_body(&n,
+                 "GPGSV,2,1,08,05,02,020,,07,,,33,16,76,272,33,18,58,069,31");
+      parse_body(&n, "GPGSV,2,2,08,20,,,24,23,28,121,20,26,,,31,27,46,274,32");
+      snprintf(body, sizeof(body),
+               "GPGLL,5104.34432,N,00147.29814,W,17545%u.00,A,A", second);
+      parse_body(&n, body);
+      ++second;
+    }
+    nmea_epoch_flush(&a);
+
+    if (e.count != 3) {
+      printf("ERR: %u epochs for 3 seconds\n", e.count);
+      return -1;
+    }
+    unsigned int i = 0;
+    while (i < 3) {
+      if ((e.epoch[i].complete != 1) ||
+          (e.epoch[i].data.time != (0x604664f0 - 6 + i))) {
+        printf("ERR: epoch %u of the cycle incorrect\n", i);
+        return -1;
+      }
+      ++i;
+    }
+    ++r;
+  }
+  return 0;
+}
+
+/* test that a receiver that outputs ten times a second gets an epoch for each
+ * cycle with that cycle's data, rather than one per second */
+int test_epoch_10hz(void) {
+  struct nmea_epoch_assembler a;
+  struct epochs e;
+  e.count = 0;
+  nmea_epoch_init(&a, NMEA_SENTENCE_RMC_MASK | NMEA_SENTENCE_GGA_MASK, 100,
+                  &record, &e);
+  struct nmea n;
+  nmea_init(&n);
+  const struct nmea_callback callbacks[] = {{&nmea_epoch_callback,
+                                             ~(nmea_sentence_bitmap_t)0,
+                                             ~(nmea_field_bitmap_t)0, &a}};
+  nmea_set_callbacks(&n, callbacks, 1);
+
+  unsigned int cycle = 0;
+  while (cycle < TEST_EPOCHS) {
+    char body[128];
+    snprintf(body, sizeof(body),
+             "GPRMC,175456.%u0,A,51%02u.34432,N,00147.29814,W,34.075,213.73,"
+             "080321,,,A",
+             cycle, cycle);
+    parse_body(&n, body);
+    snprintf(body, sizeof(body),
+             "GPGGA,175456.%u0,51%02u.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+             "47.5,M,,",
+             cycle, cycle);
+    parse_body(&n, body);
+    /* sentences after the required ones, the GSA only once a second */
+    if (cycle == 0) {
+      parse_body(&n, "GPGSA,A,2,18,16,23,,,,,,,,,,3.05,2.88,1.00");
+    }
+    snprintf(body, sizeof(body),
+             "GPGLL,51%02u.34432,N,00147.29814,W,175456.%u0,A,A", cycle,
+             cycle);
+    parse_body(&n, body);
+    ++cycle;
+  }
+  nmea_epoch_flush(&a);
+
+  if (e.count != TEST_EPOCHS) {
+    printf("ERR: %u epochs for %u cycles\n", e.count, TEST_EPOCHS);
+    return -1;
+  }
+  unsigned int i = 0;
+  while (i < TEST_EPOCHS) {
+    /* each cycle's latitude is i minutes further north */
+    const struct nmea_epoch *const epoch = &e.epoch[i];
+    const double latitude =
+        nmea_fxp_to_double(epoch->data.latitude, NMEA_FIELD_LATITUDE);
+    const double expected = 51.0 + ((i + 0.34432) / 60.0);
+    if ((epoch->complete != 1) || (epoch->data.time != 0x604664f0) ||
+        ((latitude - expected) > 0.00001) ||
+        ((expected - latitude) > 0.00001)) {
+      printf("ERR: epoch %u of the 10 Hz cycle incorrect\n", i);
+      return -1;
+    }
+    ++i;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+
+  int rc;
+
+  rc = test_epoch();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_epoch_cycle();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_epoch_10hz();
+  if (rc != 0) {
+    return rc;
+  }
+
+  return 0;
+}
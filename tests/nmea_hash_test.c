@@ -0,0 +1,55 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Includes nmea.c to reach its static lookup tables, so is built on its own
+ * rather than linked with it:
+ *
+ *   gcc -o nmea_hash_test nmea_hash_test.c */
+
+#include "../nmea.c"
+
+#include <stdio.h>
+
+/* test that every formatter in SENTENCE_LUT hashes to its own slot of
+ * SENTENCE_HASH_LUT, so a formatter added with a colliding hash can't silently
+ * replace another */
+int test_sentence_hash(void) {
+  unsigned char i = 0;
+  while (i < (sizeof(SENTENCE_LUT) / sizeof(SENTENCE_LUT[0]))) {
+    const char *const f = SENTENCE_LUT[i].head;
+    const unsigned char hash = FORMATTER_HASH(FORMATTER_PACK(f[0], f[1], f[2]));
+    if ((hash >= (sizeof(SENTENCE_HASH_LUT) / sizeof(SENTENCE_HASH_LUT[0]))) ||
+        (SENTENCE_HASH_LUT[hash] != (i + 1))) {
+      printf("ERR: %s is not in its slot of the sentence hash\n", f);
+      return -1;
+    }
+    ++i;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+
+  int rc;
+
+  rc = test_sentence_hash();
+  if (rc != 0) {
+    return rc;
+  }
+
+  return 0;
+}
@@ -0,0 +1,207 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* must be defined before any system headers are included */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "../nmea_index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_SENTENCES (4000)
+
+/* the time after each sentence with one and where the sentence ends */
+struct times {
+  long long int time[TEST_SENTENCES];
+  size_t end[TEST_SENTENCES];
+  size_t count;
+  const char *buf;
+};
+
+static void record_time(struct nmea *const n, const char *const sentence,
+                        const size_t len, const nmea_field_bitmap_t fields,
+                        void *const ctx) {
+  struct times *const t = ctx;
+  if (((fields & NMEA_FIELD_TIME_MASK) == 0) || (t->count >= TEST_SENTENCES)) {
+    return;
+  }
+  t->time[t->count] = n->data.time;
+  t->end[t->count] = (sentence - t->buf) + len;
+  ++t->count;
+}
+
+/* writes a capture of GGA, GSV and occasional RMC sentences that crosses
+ * midnight, so most of it takes its date from an RMC long before */
+static int write_capture(char *const path) {
+  static const char *const gsv[] = {
+      "$GPGSV,2,1,08,05,02,020,,07,,,33,16,76,272,33,18,58,069,31*48\r\n",
+      "$GPGSV,2,2,08,20,,,24,23,28,121,20,26,,,31,27,46,274,32*7F\r\n"};
+  const int fd = mkstemp(path);
+  if (fd < 0) {
+    return -1;
+  }
+  FILE *const f = fdopen(fd, "wb");
+  if (f == 0) {
+    close(fd);
+    return -1;
+  }
+  unsigned long int t = 86400 - 1200;
+  unsigned int i = 0;
+  while (i < TEST_SENTENCES) {
+    char body[96];
+    const unsigned long int tod = t % 86400;
+    const unsigned int hms =
+        ((tod / 3600) * 10000) + (((tod / 60) % 60) * 100) + (tod % 60);
+    if ((i % 4) == 1) {
+      fputs(gsv[0], f);
+      fputs(gsv[1], f);
+      ++i;
+      continue;
+    }
+    if ((i % 1000) == 0) {
+      snprintf(body, sizeof(body),
+               "GPRMC,%06u.00,A,5104.34432,N,00147.29814,W,34.075,213.73,"
+               "%s,,,A",
+               hms, (t < 86400) ? "080321" : "090321");
+    } else {
+      snprintf(body, sizeof(body),
+               "GPGGA,%06u.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+               "47.5,M,,",
+               hms);
+    }
+    ++t;
+    unsigned char checksum = 0;
+    const char *p = body;
+    while (*p) {
+      checksum ^= *p;
+      ++p;
+    }
+    fprintf(f, "$%s*%02X\r\n", body, checksum);
+    ++i;
+  }
+  return fclose(f);
+}
+
+/* test that parsing from a seek point gives the same times as parsing from the
+ * start, including through an index saved and loaded again */
+int test_index(void) {
+  char path[] = "/tmp/nmea_index_testXXXXXX";
+  char idx_path[] = "/tmp/nmea_index_test_idxXXXXXX";
+  if (write_capture(path) != 0) {
+    printf("ERR: failed to write the test capture\n");
+    return -1;
+  }
+  const int fd = mkstemp(idx_path);
+  if (fd < 0) {
+    printf("ERR: failed to create the index file\n");
+    unlink(path);
+    return -1;
+  }
+  close(fd);
+
+  struct nmea_mmap m;
+  if (nmea_mmap_open(&m, path) != 0) {
+    printf("ERR: failed to map the test capture\n");
+    unlink(path);
+    unlink(idx_path);
+    return -1;
+  }
+  static struct times linear;
+  linear.count = 0;
+  linear.buf = m.buf;
+  struct nmea n;
+  nmea_init(&n);
+  nmea_mmap_parse(&m, &n, 0, &record_time, &linear);
+
+  int rc = 0;
+  struct nmea_index built;
+  struct nmea_index idx;
+  if ((nmea_index_build(&built, &m, 60) != 0) ||
+      (nmea_index_save(&built, idx_path) != 0) ||
+      (nmea_index_load(&idx, idx_path) != 0)) {
+    printf("ERR: failed to build, save or load the index\n");
+    rc = -1;
+  } else if ((idx.count != built.count) || (idx.count < 20) ||
+             (memcmp(idx.entries, built.entries,
+                     idx.count * sizeof(idx.entries[0])) != 0)) {
+    printf("ERR: the loaded index differs, %lu entries\n",
+           (unsigned long int)idx.count);
+    rc = -1;
+  }
+  if (rc == 0) {
+    nmea_index_free(&built);
+  }
+
+  static struct times seeked;
+  size_t i = 0;
+  while ((rc == 0) && (i < linear.count)) {
+    const long long int target = linear.time[i];
+    nmea_init(&n);
+    const size_t offset = nmea_index_seek(&idx, &n, target);
+    seeked.count = 0;
+    seeked.buf = m.buf;
+    nmea_mmap_parse(&m, &n, offset, &record_time, &seeked);
+    /* the sentences after the seek point match those from the start */
+    size_t first = 0;
+    while ((first < linear.count) && (linear.end[first] <= offset)) {
+      ++first;
+    }
+    if ((seeked.count != (linear.count - first)) || (seeked.count == 0) ||
+        ((seeked.time[0] > target) && (target >= idx.entries[0].time)) ||
+        (memcmp(seeked.time, &linear.time[first],
+                seeked.count * sizeof(seeked.time[0])) != 0)) {
+      printf("ERR: seeking to %lld gives different times\n", target);
+      rc = -1;
+    }
+    if ((first > i) && (offset != 0)) {
+      printf("ERR: seeking to %lld went past it\n", target);
+      rc = -1;
+    }
+    i += 97;
+  }
+
+  if (rc == 0) {
+    nmea_index_free(&idx);
+  }
+  nmea_mmap_close(&m);
+  unlink(path);
+
+  if ((rc == 0) && ((truncate(idx_path, 20) != 0) ||
+                    (nmea_index_load(&idx, idx_path) != -1))) {
+    printf("ERR: loaded a truncated index\n");
+    rc = -1;
+  }
+  unlink(idx_path);
+  return rc;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+
+  int rc;
+
+  rc = test_index();
+  if (rc != 0) {
+    return rc;
+  }
+
+  return 0;
+}
@@ -0,0 +1,191 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* must be defined before any system headers are included */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "../nmea_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_LOG_RECORDS (100)
+
+struct expected {
+  struct nmea_data data[TEST_LOG_RECORDS];
+  nmea_field_bitmap_t fields[TEST_LOG_RECORDS];
+  size_t count;
+};
+
+static void expect(const struct nmea_data *const data,
+                   const enum nmea_sentences sentence,
+                   const nmea_field_bitmap_t fields, void *const ctx) {
+  struct expected *const e = ctx;
+  (void)sentence;
+  if (e->count < TEST_LOG_RECORDS) {
+    /* only the fields the sentence set are logged, without the per satellite
+     * values */
+    struct nmea_data *const d = &e->data[e->count];
+    memset(d, 0, sizeof(*d));
+    nmea_data_merge(d, data, fields);
+    memset(d->sats, 0, sizeof(d->sats));
+    d->talker = data->talker;
+    e->fields[e->count] = fields;
+    ++e->count;
+  }
+}
+
+/* test that the records read back from a log match the parser's data for each
+ * sentence, across full and partial blocks */
+int test_log(void) {
+  static const char *const sentences[] = {
+      "$GPRMC,175456.00,A,5104.34432,N,00147.29814,W,34.075,213.73,"
+      "080321,,,A*47\r\n",
+      "$GPVTG,213.73,T,,M,34.075,N,63.106,K,A*3E\r\n",
+      "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+      "47.5,M,,*74\r\n",
+      "$GPGSA,A,2,18,16,23,,,,,,,,,,3.05,2.88,1.00*09\r\n",
+      "$GPGSV,2,1,08,05,02,020,,07,,,33,16,76,272,33,18,58,069,31*48\r\n",
+      "$GPGSV,2,2,08,20,,,24,23,28,121,20,26,,,31,27,46,274,32*7F\r\n",
+      "$GPGLL,5104.34432,N,00147.29814,W,175456.00,A,A*79\r\n"};
+  char path[] = "/tmp/nmea_log_testXXXXXX";
+  const int fd = mkstemp(path);
+  if (fd < 0) {
+    printf("ERR: failed to create the test log\n");
+    return -1;
+  }
+  close(fd);
+
+  static struct expected e;
+  e.count = 0;
+  struct nmea_log_writer w;
+  if (nmea_log_writer_open(&w, path, 8) != 0) {
+    printf("ERR: failed to open the log writer\n");
+    unlink(path);
+    return -1;
+  }
+  const struct nmea_callback callbacks[] = {
+      {&nmea_log_callback, ~(nmea_sentence_bitmap_t)0, ~(nmea_field_bitmap_t)0,
+       &w},
+      {&expect, ~(nmea_sentence_bitmap_t)0, ~(nmea_field_bitmap_t)0, &e}};
+  struct nmea n;
+  nmea_init(&n);
+  nmea_set_callbacks(&n, callbacks, 2);
+  unsigned int i = 0;
+  while (e.count < 60) {
+    const char *const s =
+        sentences[i % (sizeof(sentences) / sizeof(sentences[0]))];
+    nmea_parse_buf(&n, s, strlen(s));
+    ++i;
+  }
+  if (nmea_log_writer_close(&w) != 0) {
+    printf("ERR: failed to write the log\n");
+    unlink(path);
+    return -1;
+  }
+
+  struct nmea_log_reader r;
+  if (nmea_log_open(&r, path) != 0) {
+    printf("ERR: failed to open the log\n");
+    unlink(path);
+    return -1;
+  }
+  int rc = 0;
+  size_t count = 0;
+  size_t blocks = 0;
+  struct nmea_log_block b;
+  int next;
+  while ((rc == 0) && ((next = nmea_log_next(&r, &b)) == 1)) {
+    size_t j = 0;
+    while (j < b.count) {
+      struct nmea_data data;
+      const nmea_field_bitmap_t fields = nmea_log_record(&b, &data);
+      if ((count >= e.count) || (fields != e.fields[count]) ||
+          (memcmp(&data, &e.data[count], sizeof(data)) != 0)) {
+        printf("ERR: log record %lu differs\n", (unsigned long int)count);
+        rc = -1;
+        break;
+      }
+      ++count;
+      ++j;
+    }
+    ++blocks;
+  }
+  const size_t len = r.m.len;
+  nmea_log_close(&r);
+  if ((rc == 0) && ((next != 0) || (count != e.count) || (blocks != 8))) {
+    printf("ERR: read %lu records in %lu blocks, expected: %lu in 8\n",
+           (unsigned long int)count, (unsigned long int)blocks,
+           (unsigned long int)e.count);
+    rc = -1;
+  }
+
+  /* each record holds only the values its sentence set, so even in blocks this
+   * small the log is smaller than the sentences it was written from */
+  size_t ascii = 0;
+  size_t k = 0;
+  while (k < i) {
+    ascii += strlen(sentences[k % (sizeof(sentences) / sizeof(sentences[0]))]);
+    ++k;
+  }
+  if ((rc == 0) && (len >= ascii)) {
+    printf("ERR: log of %lu bytes for %lu bytes of sentences\n",
+           (unsigned long int)len, (unsigned long int)ascii);
+    rc = -1;
+  }
+
+  /* a truncated block is an error rather than the end of the log */
+  if ((rc == 0) && (truncate(path, len - 1) == 0)) {
+    if (nmea_log_open(&r, path) != 0) {
+      printf("ERR: failed to open the truncated log\n");
+      rc = -1;
+    } else {
+      while ((next = nmea_log_next(&r, &b)) == 1) {
+      }
+      nmea_log_close(&r);
+      if (next != -1) {
+        printf("ERR: truncated log read without error\n");
+        rc = -1;
+      }
+    }
+  }
+
+  if ((rc == 0) && (truncate(path, 0) == 0) &&
+      (nmea_log_open(&r, path) != -1)) {
+    printf("ERR: opened an empty file as a log\n");
+    rc = -1;
+  }
+
+  unlink(path);
+  return rc;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+
+  int rc;
+
+  rc = test_log();
+  if (rc != 0) {
+    return rc;
+  }
+
+  return 0;
+}
@@ -0,0 +1,170 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* must be defined before any system headers are included */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "../nmea_mmap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct sentences {
+  const char *sentence[4];
+  size_t len[4];
+  nmea_field_bitmap_t fields[4];
+  unsigned int count;
+};
+
+static void record(struct nmea *const n, const char *const sentence,
+                   const size_t len, const nmea_field_bitmap_t fields,
+                   void *const ctx) {
+  struct sentences *const s = ctx;
+  (void)n;
+  if (s->count < 4) {
+    s->sentence[s->count] = sentence;
+    s->len[s->count] = len;
+    s->fields[s->count] = fields;
+  }
+  ++s->count;
+}
+
+static int write_file(char *const path, const char *const s) {
+  const int fd = mkstemp(path);
+  if (fd < 0) {
+    return -1;
+  }
+  const size_t len = strlen(s);
+  const ssize_t written = write(fd, s, len);
+  close(fd);
+  return (written == (ssize_t)len) ? 0 : -1;
+}
+
+/* test that each sentence that sets fields is passed to the callback in place
+ * in the mapped file, from any starting offset */
+int test_mmap_parse(void) {
+  static const char s[] =
+      "GGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,"
+      "*74\r\n"
+      "$GPRMC,175456.00,A,5104.34432,N,00147.29814,W,34.075,213.73,"
+      "080321,,,A*47\r\n"
+      "$GPTXT,01,01,02,ANTSTATUS=OK*3B\r\n"
+      "$GPVTG,213.73,T,,M,34.075,N,63.106,K,A*3E\r\n";
+
+  char path[] = "/tmp/nmea_mmap_testXXXXXX";
+  if (write_file(path, s) != 0) {
+    printf("ERR: failed to write the test file\n");
+    return -1;
+  }
+  struct nmea_mmap m;
+  const int rc = nmea_mmap_open(&m, path);
+  unlink(path);
+  if ((rc != 0) || (m.len != (sizeof(s) - 1))) {
+    printf("ERR: failed to map the test file\n");
+    return -1;
+  }
+
+  struct nmea n;
+  struct sentences found;
+  found.count = 0;
+  nmea_init(&n);
+  nmea_mmap_parse(&m, &n, 0, &record, &found);
+
+  const char *const rmc = strstr(m.buf, "$GPRMC");
+  const char *const vtg = strstr(m.buf, "$GPVTG");
+  if ((found.count != 2) || (found.sentence[0] != rmc) ||
+      (found.len[0] != (size_t)(strstr(rmc, "*47") + 3 - rmc)) ||
+      (found.sentence[1] != vtg) ||
+      (found.len[1] != (size_t)(strstr(vtg, "*3E") + 3 - vtg))) {
+    printf("ERR: mapped sentences incorrect, found %u\n", found.count);
+    nmea_mmap_close(&m);
+    return -1;
+  }
+  if (((found.fields[0] & NMEA_FIELD_DATE_MASK) == 0) ||
+      ((found.fields[1] & NMEA_FIELD_SPEED_MASK) == 0) ||
+      (n.state.received != 0)) {
+    printf("ERR: mapped sentence fields incorrect\n");
+    nmea_mmap_close(&m);
+    return -1;
+  }
+
+  /* starting part way through the RMC sentence only finds the VTG */
+  found.count = 0;
+  nmea_init(&n);
+  nmea_mmap_parse(&m, &n, (rmc - m.buf) + 10, &record, &found);
+  if ((found.count != 1) || (found.sentence[0] != vtg)) {
+    printf("ERR: mapped sentences from an offset incorrect\n");
+    nmea_mmap_close(&m);
+    return -1;
+  }
+
+  nmea_mmap_close(&m);
+  return 0;
+}
+
+/* test empty and missing files */
+int test_mmap_open(void) {
+  char path[] = "/tmp/nmea_mmap_testXXXXXX";
+  if (write_file(path, "") != 0) {
+    printf("ERR: failed to write the test file\n");
+    return -1;
+  }
+  struct nmea_mmap m;
+  if ((nmea_mmap_open(&m, path) != 0) || (m.len != 0)) {
+    printf("ERR: failed to map an empty file\n");
+    unlink(path);
+    return -1;
+  }
+  struct nmea n;
+  struct sentences found;
+  found.count = 0;
+  nmea_init(&n);
+  nmea_mmap_parse(&m, &n, 0, &record, &found);
+  nmea_mmap_close(&m);
+  unlink(path);
+  if (found.count != 0) {
+    printf("ERR: empty file parsed sentences\n");
+    return -1;
+  }
+
+  if (nmea_mmap_open(&m, path) != -1) {
+    printf("ERR: missing file mapped\n");
+    return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+
+  int rc;
+
+  rc = test_mmap_parse();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_mmap_open();
+  if (rc != 0) {
+    return rc;
+  }
+
+  return 0;
+}
@@ -0,0 +1,191 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* must be defined before any system headers are included */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "../nmea_parallel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_SENTENCES (3000)
+
+/* the values compared between parsers for each sentence */
+struct result {
+  nmea_field_bitmap_t fields;
+  long long int time;
+  long long int latitude;
+  long int altitude;
+  unsigned char prn;
+  unsigned short int satellites_in_view;
+};
+
+struct results {
+  struct result r[TEST_SENTENCES];
+  size_t count;
+};
+
+static void record(const struct nmea_data *const data,
+                   const nmea_field_bitmap_t fields, void *const ctx) {
+  struct results *const rs = ctx;
+  if (rs->count >= TEST_SENTENCES) {
+    return;
+  }
+  struct result *const r = &rs->r[rs->count];
+  r->fields = fields;
+  r->time = data->time;
+  r->latitude = data->latitude;
+  r->altitude = data->altitude;
+  r->prn = data->sats[7].prn;
+  r->satellites_in_view = data->satellites_in_view;
+  ++rs->count;
+}
+
+/* writes a log of RMC, GGA and GSV sentences that crosses midnight, with the
+ * dated RMC sentences far enough apart that chunks start without a date */
+static int write_log(char *const path) {
+  static const char *const gsv[] = {
+      "$GPGSV,2,1,08,05,02,020,,07,,,33,16,76,272,33,18,58,069,31*48\r\n",
+      "$GPGSV,2,2,08,20,,,24,23,28,121,20,26,,,31,27,46,274,32*7F\r\n"};
+  const int fd = mkstemp(path);
+  if (fd < 0) {
+    return -1;
+  }
+  FILE *const f = fdopen(fd, "wb");
+  if (f == 0) {
+    close(fd);
+    return -1;
+  }
+  unsigned long int t = 86400 - 300;
+  unsigned int i = 0;
+  while (i < TEST_SENTENCES) {
+    char body[96];
+    const unsigned long int tod = t % 86400;
+    const unsigned int hms =
+        ((tod / 3600) * 10000) + (((tod / 60) % 60) * 100) + (tod % 60);
+    switch (i % 5) {
+    case 0:
+      if ((i % 400) != 0) {
+        ++i;
+        continue;
+      }
+      snprintf(body, sizeof(body),
+               "GPRMC,%06u.00,A,5104.34432,N,00147.29814,W,34.075,213.73,"
+               "%s,,,A",
+               hms, (t < 86400) ? "080321" : "090321");
+      break;
+    case 1:
+    case 2:
+      fputs(gsv[(i % 5) - 1], f);
+      ++i;
+      continue;
+    default:
+      snprintf(body, sizeof(body),
+               "GPGGA,%06u.00,51%02u.34432,N,00147.29814,W,1,03,2.88,%u.8,M,"
+               "47.5,M,,",
+               hms, i % 60, i % 100);
+      ++t;
+      break;
+    }
+    unsigned char checksum = 0;
+    const char *p = body;
+    while (*p) {
+      checksum ^= *p;
+      ++p;
+    }
+    fprintf(f, "$%s*%02X\r\n", body, checksum);
+    ++i;
+  }
+  return fclose(f);
+}
+
+/* test that parsing in parallel gives the same results as a single parser */
+int test_parallel(void) {
+  char path[] = "/tmp/nmea_parallel_testXXXXXX";
+  if (write_log(path) != 0) {
+    printf("ERR: failed to write the test log\n");
+    return -1;
+  }
+
+  static struct results single;
+  static struct results parallel;
+  single.count = 0;
+
+  FILE *const f = fopen(path, "rb");
+  static char buf[TEST_SENTENCES * 96];
+  const size_t len = fread(buf, 1, sizeof(buf), f);
+  fclose(f);
+  struct nmea n;
+  nmea_init(&n);
+  size_t i = 0;
+  while (i < len) {
+    i += nmea_parse_buf(&n, &buf[i], len - i);
+    const nmea_field_bitmap_t fields = n.state.received;
+    if (fields != 0) {
+      nmea_decode(&n, fields);
+      n.state.received = 0;
+      record(&n.data, fields, &single);
+    }
+  }
+
+  unsigned int threads = 1;
+  while (threads <= 7) {
+    parallel.count = 0;
+    if (nmea_parse_file_parallel(path, threads, &record, &parallel) != 0) {
+      printf("ERR: parallel parse with %u threads failed\n", threads);
+      unlink(path);
+      return -1;
+    }
+    if ((parallel.count != single.count) ||
+        (memcmp(parallel.r, single.r, single.count * sizeof(single.r[0])) !=
+         0)) {
+      printf("ERR: parallel parse with %u threads differs, %lu results, "
+             "expected: %lu\n",
+             threads, (unsigned long int)parallel.count,
+             (unsigned long int)single.count);
+      unlink(path);
+      return -1;
+    }
+    ++threads;
+  }
+
+  unlink(path);
+
+  if (nmea_parse_file_parallel(path, 2, &record, &parallel) != -1) {
+    printf("ERR: parallel parse of a missing file succeeded\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+
+  int rc;
+
+  rc = test_parallel();
+  if (rc != 0) {
+    return rc;
+  }
+
+  return 0;
+}
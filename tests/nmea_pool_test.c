@@ -0,0 +1,95 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../nmea_pool.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* test that inputs split across batches are parsed by the parser of their own
+ * stream and update only its columns */
+int test_pool_parse(void) {
+  static const char gga[] =
+      "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,"
+      "*74\r\n";
+  static const char rmc[] =
+      "$GPRMC,175456.00,A,5104.34432,N,00147.29814,W,34.075,213.73,080321,,,A"
+      "*47\r\n";
+
+  struct nmea_pool p;
+  if (nmea_pool_init(&p, 3) != 0) {
+    printf("ERR: pool allocation failed\n");
+    return -1;
+  }
+
+  /* stream 0 gets the first half of the GGA sentence, stream 2 the RMC */
+  const size_t half = (sizeof(gga) - 1) / 2;
+  struct nmea_pool_input first[] = {{0, gga, half},
+                                    {2, rmc, sizeof(rmc) - 1},
+                                    {3, rmc, sizeof(rmc) - 1}};
+  nmea_pool_parse(&p, first, sizeof(first) / sizeof(first[0]));
+
+  if ((p.received[0] != 0) || (p.received[1] != 0) ||
+      (p.received[2] !=
+       (NMEA_FIELD_LATITUDE_MASK | NMEA_FIELD_LONGITUDE_MASK |
+        NMEA_FIELD_TIME_MASK | NMEA_FIELD_DATE_MASK | NMEA_FIELD_SPEED_MASK |
+        NMEA_FIELD_TRUE_TRACK_MASK))) {
+    printf("ERR: pool flags incorrect after the first batch %lx %lx %lx\n",
+           p.received[0], p.received[1], p.received[2]);
+    nmea_pool_free(&p);
+    return -1;
+  }
+  if ((p.time[2] != 0x604664f0) || (p.speed[2] == 0) ||
+      (p.latitude[2] == 0) || (p.latitude[0] != 0)) {
+    printf("ERR: pool RMC columns incorrect\n");
+    nmea_pool_free(&p);
+    return -1;
+  }
+
+  struct nmea_pool_input second[] = {{0, &gga[half], sizeof(gga) - 1 - half}};
+  nmea_pool_parse(&p, second, sizeof(second) / sizeof(second[0]));
+
+  if ((p.received[0] & NMEA_FIELD_ALTITUDE_MASK) == 0) {
+    printf("ERR: pool GGA did not set the required field flags %lx\n",
+           p.received[0]);
+    nmea_pool_free(&p);
+    return -1;
+  }
+  if ((p.latitude[0] != p.latitude[2]) || (p.longitude[0] != p.longitude[2]) ||
+      (p.fix_quality[0] != NMEA_FIX_GPS_FIX) ||
+      (p.satellites_tracked[0] != 3) || (p.altitude[0] == 0) ||
+      (p.altitude[2] != 0)) {
+    printf("ERR: pool GGA columns incorrect\n");
+    nmea_pool_free(&p);
+    return -1;
+  }
+
+  nmea_pool_free(&p);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+
+  int rc;
+
+  rc = test_pool_parse();
+  if (rc != 0) {
+    return rc;
+  }
+
+  return 0;
+}
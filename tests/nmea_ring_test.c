@@ -0,0 +1,268 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../nmea.h"
+#include "../nmea_ring.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_RING_BYTES (1ul << 22)
+
+/* a small ring so that the indices wrap often */
+static const size_t TEST_RING_SIZE = 64;
+
+/* each thread has its own generator, rand is not thread safe */
+static unsigned long int lcg(unsigned long int *const state) {
+  *state = (*state * 1103515245ul) + 12345ul;
+  return (*state >> 16) & 0x7fff;
+}
+
+static char pattern(const unsigned long int i) {
+  return (char)((i * 7) ^ (i >> 8));
+}
+
+static void *stress_producer(void *const arg) {
+  struct nmea_ring *const r = arg;
+  unsigned long int seed = 1;
+  char buf[100];
+  unsigned long int i = 0;
+  while (i < TEST_RING_BYTES) {
+    size_t len = (lcg(&seed) % sizeof(buf)) + 1;
+    if (len > (TEST_RING_BYTES - i)) {
+      len = TEST_RING_BYTES - i;
+    }
+    size_t j = 0;
+    while (j < len) {
+      buf[j] = pattern(i + j);
+      ++j;
+    }
+    size_t pushed = 0;
+    while (pushed < len) {
+      const size_t n = nmea_ring_push(r, &buf[pushed], len - pushed);
+      if (n == 0) {
+        /* let the consumer run if they share a CPU */
+        sched_yield();
+      }
+      pushed += n;
+    }
+    i += len;
+  }
+  return 0;
+}
+
+/* test that bytes come out of the ring in order, through both pop and peek,
+ * with pushes and pops of random sizes on 2 threads */
+int test_ring_stress(void) {
+  struct nmea_ring r;
+  if (nmea_ring_init(&r, TEST_RING_SIZE) != 0) {
+    printf("ERR: ring allocation failed\n");
+    return -1;
+  }
+  pthread_t producer;
+  if (pthread_create(&producer, 0, &stress_producer, &r) != 0) {
+    printf("ERR: failed to start the producer\n");
+    nmea_ring_free(&r);
+    return -1;
+  }
+
+  unsigned long int seed = 2;
+  char buf[100];
+  int rc = 0;
+  unsigned long int i = 0;
+  while ((i < TEST_RING_BYTES) && (rc == 0)) {
+    const char *p = buf;
+    size_t len;
+    if ((lcg(&seed) & 1) != 0) {
+      len = nmea_ring_pop(&r, buf, (lcg(&seed) % sizeof(buf)) + 1);
+    } else {
+      len = nmea_ring_peek(&r, &p);
+    }
+    size_t j = 0;
+    while (j < len) {
+      if (p[j] != pattern(i + j)) {
+        printf("ERR: ring byte %lu incorrect\n", i + j);
+        rc = -1;
+        break;
+      }
+      ++j;
+    }
+    if (p != buf) {
+      nmea_ring_release(&r, len);
+    }
+    if (len == 0) {
+      sched_yield();
+    }
+    i += len;
+  }
+
+  pthread_join(producer, 0);
+  nmea_ring_free(&r);
+  return rc;
+}
+
+/* test that pushes and pops of random sizes on a single thread wrap around
+ * the end of the buffer intact, whatever the timing of the threads above */
+int test_ring_wrap(void) {
+  struct nmea_ring r;
+  if (nmea_ring_init(&r, TEST_RING_SIZE) != 0) {
+    printf("ERR: ring allocation failed\n");
+    return -1;
+  }
+  unsigned long int seed = 3;
+  unsigned long int in = 0;
+  unsigned long int out = 0;
+  char buf[100];
+  while (out < 100000) {
+    size_t len = (lcg(&seed) % sizeof(buf)) + 1;
+    size_t j = 0;
+    while (j < len) {
+      buf[j] = pattern(in + j);
+      ++j;
+    }
+    in += nmea_ring_push(&r, buf, len);
+    len = nmea_ring_pop(&r, buf, (lcg(&seed) % sizeof(buf)) + 1);
+    j = 0;
+    while (j < len) {
+      if (buf[j] != pattern(out + j)) {
+        printf("ERR: wrapped ring byte %lu incorrect\n", out + j);
+        nmea_ring_free(&r);
+        return -1;
+      }
+      ++j;
+    }
+    out += len;
+  }
+  nmea_ring_free(&r);
+  return 0;
+}
+
+/* test that a size that is not a power of 2 is rejected */
+int test_ring_init(void) {
+  struct nmea_ring r;
+  if (nmea_ring_init(&r, 48) != -1) {
+    printf("ERR: ring of 48 bytes allocated\n");
+    nmea_ring_free(&r);
+    return -1;
+  }
+  if (nmea_ring_init(&r, 0) != -1) {
+    printf("ERR: ring of 0 bytes allocated\n");
+    return -1;
+  }
+  return 0;
+}
+
+static const char TEST_SENTENCES[] =
+    "$GPRMC,175456.00,A,5104.34432,N,00147.29814,W,34.075,213.73,"
+    "080321,,,A*47\r\n"
+    "$GPTXT,01,01,02,ANTSTATUS=OK*3B\r\n"
+    "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+    "47.5,M,,*74\r\n";
+static const unsigned int TEST_SENTENCE_REPS = 10000;
+
+static void *parse_producer(void *const arg) {
+  struct nmea_ring *const r = arg;
+  unsigned int i = 0;
+  while (i < TEST_SENTENCE_REPS) {
+    size_t pushed = 0;
+    while (pushed < (sizeof(TEST_SENTENCES) - 1)) {
+      const size_t n = nmea_ring_push(r, &TEST_SENTENCES[pushed],
+                                      sizeof(TEST_SENTENCES) - 1 - pushed);
+      if (n == 0) {
+        sched_yield();
+      }
+      pushed += n;
+    }
+    ++i;
+  }
+  return 0;
+}
+
+/* test parsing straight out of the ring */
+int test_ring_parse(void) {
+  struct nmea_ring r;
+  if (nmea_ring_init(&r, TEST_RING_SIZE) != 0) {
+    printf("ERR: ring allocation failed\n");
+    return -1;
+  }
+  pthread_t producer;
+  if (pthread_create(&producer, 0, &parse_producer, &r) != 0) {
+    printf("ERR: failed to start the producer\n");
+    nmea_ring_free(&r);
+    return -1;
+  }
+
+  struct nmea n;
+  nmea_init(&n);
+  unsigned long int positions = 0;
+  unsigned long int remaining =
+      (unsigned long int)(sizeof(TEST_SENTENCES) - 1) * TEST_SENTENCE_REPS;
+  while (remaining != 0) {
+    const char *p;
+    const size_t len = nmea_ring_peek(&r, &p);
+    size_t used = 0;
+    while (used < len) {
+      used += nmea_parse_buf(&n, &p[used], len - used);
+      if (nmea_fields_ready(&n, NMEA_FIELD_LATITUDE_MASK) == 1) {
+        ++positions;
+      }
+    }
+    nmea_ring_release(&r, len);
+    if (len == 0) {
+      sched_yield();
+    }
+    remaining -= len;
+  }
+
+  pthread_join(producer, 0);
+  nmea_ring_free(&r);
+  if (positions != (2ul * TEST_SENTENCE_REPS)) {
+    printf("ERR: ring parse found %lu positions, expected: %lu\n", positions,
+           2ul * TEST_SENTENCE_REPS);
+    return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+
+  int rc;
+
+  rc = test_ring_init();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_ring_wrap();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_ring_stress();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_ring_parse();
+  if (rc != 0) {
+    return rc;
+  }
+
+  return 0;
+}
@@ -0,0 +1,158 @@
+/* Copyright 2019 Julian Ingram
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../nmea.h"
+#include "../nmea_snapshot.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_SNAPSHOT_PUBLISHES (2000000)
+#define TEST_SNAPSHOT_READERS (3)
+
+/* test that a sentence is published to the snapshot through the callbacks */
+int test_snapshot_callback(void) {
+  static struct nmea_snapshot s;
+  nmea_snapshot_init(&s);
+  struct nmea_snapshot_record r;
+  if (nmea_snapshot_read(&s, &r) != 0) {
+    printf("ERR: an empty snapshot has been published\n");
+    return -1;
+  }
+
+  const struct nmea_callback callbacks[] = {
+      {&nmea_snapshot_callback, ~(nmea_sentence_bitmap_t)0,
+       ~(nmea_field_bitmap_t)0, &s}};
+  struct nmea n;
+  nmea_init(&n);
+  nmea_set_callbacks(&n, callbacks, 1);
+  static const char gga[] = "$GPGGA,092725.00,4717.11399,N,00833.91590,E,1,08,"
+                            "1.01,499.6,M,48.0,M,,*5B\r\n";
+  nmea_parse_buf(&n, gga, sizeof(gga) - 1);
+
+  if (nmea_snapshot_read(&s, &r) != 1) {
+    printf("ERR: the GGA sentence was not published\n");
+    return -1;
+  }
+  nmea_decode(&n, n.state.received);
+  if ((r.data.latitude != n.data.latitude) ||
+      (r.data.longitude != n.data.longitude) ||
+      (r.data.altitude != n.data.altitude) ||
+      ((r.fields & NMEA_FIELD_LATITUDE_MASK) == 0)) {
+    printf("ERR: the snapshot doesn't match the parser\n");
+    return -1;
+  }
+  return 0;
+}
+
+static struct nmea_snapshot stress_snapshot;
+static atomic_int stress_done;
+
+/* every value in the data is derived from k, so a torn copy is detectable */
+static void stress_fill(struct nmea_data *const data, const long int k) {
+  memset(data, 0, sizeof(*data));
+  data->latitude = k;
+  data->longitude = -k;
+  data->time = k * 3;
+  data->altitude = k + 1;
+  data->satellites_in_view = (unsigned short int)k;
+  data->sats[NMEA_MAX_SATS - 1].prn = (unsigned char)k;
+  data->prns_tracked[NMEA_MAX_PRNS_TRACKED - 1] = (unsigned char)(k >> 8);
+}
+
+static void *stress_reader(void *const arg) {
+  int *const rc = arg;
+  unsigned long int last = 0;
+  while (atomic_load(&stress_done) == 0) {
+    struct nmea_snapshot_record r;
+    const unsigned long int seq = nmea_snapshot_read(&stress_snapshot, &r);
+    const long int k = r.data.latitude;
+    struct nmea_data expected;
+    stress_fill(&expected, k);
+    if ((seq < last) ||
+        ((seq != 0) && (((long int)seq != k) ||
+                        (r.fields != (nmea_field_bitmap_t)k) ||
+                        (memcmp(&r.data, &expected, sizeof(expected)) != 0)))) {
+      printf("ERR: torn snapshot read at %ld\n", k);
+      *rc = -1;
+      break;
+    }
+    last = seq;
+    sched_yield();
+  }
+  return 0;
+}
+
+/* test that readers on other threads never see a partly published snapshot */
+int test_snapshot_stress(void) {
+  nmea_snapshot_init(&stress_snapshot);
+  atomic_store(&stress_done, 0);
+  pthread_t readers[TEST_SNAPSHOT_READERS];
+  int rcs[TEST_SNAPSHOT_READERS];
+  unsigned int started = 0;
+  while (started < TEST_SNAPSHOT_READERS) {
+    rcs[started] = 0;
+    if (pthread_create(&readers[started], 0, &stress_reader, &rcs[started]) !=
+        0) {
+      break;
+    }
+    ++started;
+  }
+
+  long int k = 1;
+  while (k <= TEST_SNAPSHOT_PUBLISHES) {
+    struct nmea_data data;
+    stress_fill(&data, k);
+    nmea_snapshot_publish(&stress_snapshot, &data, (nmea_field_bitmap_t)k);
+    ++k;
+  }
+  atomic_store(&stress_done, 1);
+
+  int rc = (started == TEST_SNAPSHOT_READERS) ? 0 : -1;
+  unsigned int i = 0;
+  while (i < started) {
+    pthread_join(readers[i], 0);
+    if (rcs[i] != 0) {
+      rc = -1;
+    }
+    ++i;
+  }
+  if (rc != 0) {
+    printf("ERR: snapshot stress test failed\n");
+  }
+  return rc;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+
+  int rc;
+
+  rc = test_snapshot_callback();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_snapshot_stress();
+  if (rc != 0) {
+    return rc;
+  }
+
+  return 0;
+}
@@ -18,13 +18,23 @@
 #include <stdio.h>
 #include <string.h>
 
+/* parses s, decoding every field as each sentence completes */
 static void test_parse_string(struct nmea *const n, const char *s) {
   while (*s) {
     nmea_parse(n, *s);
+    nmea_decode(n, ~(nmea_field_bitmap_t)0);
     ++s;
   }
 }
 
+/* parses the sentence body between the '$' and the '*', adding the checksum */
+static void test_parse_body(struct nmea *const n, const char *body) {
+  char s[128];
+  snprintf(s, sizeof(s), "$%s*%02X\r\n", body,
+           nmea_checksum(body, strlen(body)));
+  test_parse_string(n, s);
+}
+
 static int double_comp(const double a, const double b, const double thresh) {
   double diff = a - b;
   if (diff < 0) {
@@ -436,6 +446,145 @@ int test_gll(void) {
   return 0;
 }
 
+/* test the checksum kernel against a char at a time xor for all alignments and
+ * lengths up to a few blocks */
+int test_checksum(void) {
+  char s[128];
+  size_t i = 0;
+  while (i < sizeof(s)) {
+    s[i] = (char)((i * 37) + 11);
+    ++i;
+  }
+
+  size_t offset = 0;
+  while (offset < 16) {
+    size_t len = 0;
+    while ((offset + len) <= sizeof(s)) {
+      unsigned char cor = 0;
+      i = 0;
+      while (i < len) {
+        cor ^= s[offset + i];
+        ++i;
+      }
+      unsigned char checksum = nmea_checksum(&s[offset], len);
+      if (checksum != cor) {
+        printf("ERR: checksum at %u of %u chars incorrect, received: 0x%x, "
+               "expected: 0x%x\n",
+               (unsigned int)offset, (unsigned int)len, checksum, cor);
+        return -1;
+      }
+      ++len;
+    }
+    ++offset;
+  }
+
+  return 0;
+}
+
+/* test that the fields of one sentence are not flagged again by the next */
+int test_consecutive(void) {
+  nmea_field_bitmap_t fields =
+      NMEA_FIELD_FIX_3D_MASK | NMEA_FIELD_PRNS_TRACKED_MASK |
+      NMEA_FIELD_PDOP_MASK | NMEA_FIELD_HDOP_MASK | NMEA_FIELD_VDOP_MASK;
+
+  struct nmea n;
+  nmea_init(&n);
+
+  test_parse_string(&n, "$GPGSA,A,2,18,16,23,,,,,,,,,,3.05,2.88,1.00*09\r\n");
+
+  if (nmea_fields_ready(&n, fields) != 1) {
+    printf("ERR: GSA did not set the required field flags %lx\n",
+           n.state.received);
+    return -1;
+  }
+
+  test_parse_string(&n, "$GPVTG,213.73,T,,M,34.075,N,63.106,K,A*3E\r\n");
+
+  nmea_field_bitmap_t cor = NMEA_FIELD_TRUE_TRACK_MASK | NMEA_FIELD_SPEED_MASK;
+  if ((n.state.received & ~NMEA_FIELD_IGNORE_MASK) != cor) {
+    printf("ERR: VTG after GSA set field flags %lx, expected: %lx\n",
+           n.state.received, cor);
+    return -1;
+  }
+
+  return 0;
+}
+
+/* test that sentences are matched whatever the talker and that the talker is
+ * recorded */
+int test_talkers(void) {
+  static const struct {
+    const char *body;
+    enum nmea_talker talker;
+  } sentences[] = {
+      {"GNGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,",
+       NMEA_TALKER_GN},
+      {"GLGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,",
+       NMEA_TALKER_GL},
+      {"GAGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,",
+       NMEA_TALKER_GA},
+      {"BDGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,",
+       NMEA_TALKER_BD},
+      {"GBGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,",
+       NMEA_TALKER_GB},
+      {"GQGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,",
+       NMEA_TALKER_GQ},
+      {"XXGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,",
+       NMEA_TALKER_OTHER},
+      {"GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,",
+       NMEA_TALKER_GP}};
+
+  unsigned char i = 0;
+  while (i < (sizeof(sentences) / sizeof(sentences[0]))) {
+    struct nmea n;
+    nmea_init(&n);
+
+    test_parse_body(&n, sentences[i].body);
+
+    if (nmea_fields_ready(&n, NMEA_FIELD_LATITUDE_MASK |
+                                  NMEA_FIELD_ALTITUDE_MASK) != 1) {
+      printf("ERR: talker %u did not set the required field flags %lx\n", i,
+             n.state.received);
+      return -1;
+    }
+    if (n.data.talker != sentences[i].talker) {
+      printf("ERR: talker %u incorrect, received: %u, expected: %u\n", i,
+             n.data.talker, sentences[i].talker);
+      return -1;
+    }
+    ++i;
+  }
+
+  /* a GSV set from one talker is abandoned when another talker's set starts */
+  struct nmea n;
+  nmea_init(&n);
+
+  test_parse_string(
+      &n, "$GPGSV,2,1,08,05,02,020,,07,,,33,16,76,272,33,18,58,069,31*48");
+  test_parse_body(&n, "GLGSV,1,1,02,65,10,100,20,66,20,200,30");
+
+  if (nmea_fields_ready(&n, NMEA_FIELD_PRN_MASK) != 1) {
+    printf("ERR: GLGSV did not set the required field flags %lx\n",
+           n.state.received);
+    return -1;
+  }
+  if ((n.data.satellites_in_view != 2) || (n.data.sats[0].prn != 65) ||
+      (n.data.sats[1].prn != 66) || (n.data.talker != NMEA_TALKER_GL)) {
+    printf("ERR: GLGSV satellites incorrect\n");
+    return -1;
+  }
+
+  test_parse_string(
+      &n, "$GPGSV,2,2,08,20,,,24,23,28,121,20,26,,,31,27,46,274,32*7F");
+
+  if (nmea_fields_ready(&n, NMEA_FIELD_PRN_MASK) != 0) {
+    printf("ERR: abandoned GPGSV set completed\n");
+    return -1;
+  }
+
+  return 0;
+}
+
 /* test unsupported sentence to make sure it is ignored */
 int test_txt(void) {
   char s[] = "$GPTXT,01,01,02,ANTSTATUS=OK*3B";
@@ -452,6 +601,81 @@ int test_txt(void) {
   return 0;
 }
 
+/* test that buffer parsing stops after each sentence that sets new fields and
+ * otherwise matches char at a time parsing */
+int test_parse_buf(void) {
+  char s[] = "$GPRMC,175456.00,A,5104.34432,N,00147.29814,W,34.075,213.73,"
+             "080321,,,A*47\r\n"
+             "$GPTXT,01,01,02,ANTSTATUS=OK*3B\r\n"
+             "$GPVTG,213.73,T,,M,34.075,N,63.106,K,A*3E\r\n"
+             "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+             "47.5,M,,*74\r\n";
+  size_t len = sizeof(s) - 1;
+  const char *ends[] = {strstr(s, "*47") + 3, strstr(s, "*3E") + 3,
+                        strstr(s, "*74") + 3, s + len};
+  nmea_field_bitmap_t fields[] = {NMEA_FIELD_DATE_MASK, NMEA_FIELD_SPEED_MASK,
+                                  NMEA_FIELD_ALTITUDE_MASK, 0};
+
+  struct nmea n;
+  nmea_init(&n);
+
+  const char *p = s;
+  unsigned char i = 0;
+  while (i < (sizeof(ends) / sizeof(ends[0]))) {
+    size_t used = nmea_parse_buf(&n, p, len);
+    nmea_decode(&n, ~(nmea_field_bitmap_t)0);
+    p += used;
+    len -= used;
+    if (p != ends[i]) {
+      printf("ERR: buffer parse %u stopped at %ld, expected: %ld\n", i,
+             (long int)(p - s), (long int)(ends[i] - s));
+      return -1;
+    }
+    if ((fields[i] != 0) && (nmea_fields_ready(&n, fields[i]) != 1)) {
+      printf("ERR: buffer parse %u did not set the required field flags %lx\n",
+             i, n.state.received);
+      return -1;
+    }
+    ++i;
+  }
+
+  struct nmea cn;
+  nmea_init(&cn);
+  test_parse_string(&cn, s);
+  if (memcmp(&n.data, &cn.data, sizeof(n.data)) != 0) {
+    printf("ERR: buffer parse data differs from char parse\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+/* test that headers that only partially match a supported sentence are
+ * ignored */
+int test_header_length(void) {
+  static const char *const bodies[] = {
+      "GPGGAA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,",
+      "GPGG,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,",
+      "PGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,",
+      "GPGGAGPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+      "47.5,M,,"};
+
+  unsigned char i = 0;
+  while (i < (sizeof(bodies) / sizeof(bodies[0]))) {
+    struct nmea n;
+    nmea_init(&n);
+
+    test_parse_body(&n, bodies[i]);
+
+    if (n.state.received != 0) {
+      printf("ERR: header %u not ignored: %lx\n", i, n.state.received);
+      return -1;
+    }
+    ++i;
+  }
+  return 0;
+}
+
 static const unsigned long int TEST_RANDOM_REPS = 100000;
 static const int TEST_RANDOM_SEED = 1;
 
@@ -478,6 +702,477 @@ int test_random(void) {
   return 0;
 }
 
+static const unsigned long int TEST_BUF_RANDOM_REPS = 2000;
+
+/* test buffer parsing of valid sentences mixed with noise against char at a
+ * time parsing, with the input split into randomly sized buffers */
+int test_parse_buf_random(void) {
+  static const char *const sentences[] = {
+      "$GPRMC,175456.00,A,5104.34432,N,00147.29814,W,34.075,213.73,"
+      "080321,,,A*47\r\n",
+      "$GPVTG,213.73,T,,M,34.075,N,63.106,K,A*3E\r\n",
+      "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+      "47.5,M,,*74\r\n",
+      "$GPGSA,A,2,18,16,23,,,,,,,,,,3.05,2.88,1.00*09\r\n",
+      "$GPGSV,2,1,08,05,02,020,,07,,,33,16,76,272,33,18,58,069,31*48\r\n",
+      "$GPGSV,2,2,08,20,,,24,23,28,121,20,26,,,31,27,46,274,32*7F\r\n",
+      "$GPGLL,5104.34432,N,00147.29814,W,175456.00,A,A*79\r\n",
+      "$GPTXT,01,01,02,ANTSTATUS=OK*3B\r\n",
+      "$GPGGA,175457.00,5104.34432,S,00147.29814,E,1,03,2.88,61.8,M,"
+      "47.5,M,,*75\r\n"};
+  static const char noise[] = "$,*\r\n0123456789.ANSWEG";
+  static char s[64 * 1024];
+
+  srand(TEST_RANDOM_SEED);
+
+  size_t len = 0;
+  while ((len + 128) < sizeof(s)) {
+    if ((rand() % 8) == 0) {
+      s[len] = noise[rand() % (sizeof(noise) - 1)];
+      ++len;
+    } else {
+      const char *sentence =
+          sentences[rand() % (sizeof(sentences) / sizeof(sentences[0]))];
+      size_t slen = strlen(sentence);
+      memcpy(&s[len], sentence, slen);
+      len += slen;
+    }
+  }
+
+  struct nmea bn;
+  struct nmea cn;
+  nmea_init(&bn);
+  nmea_init(&cn);
+
+  unsigned long int rep = 0;
+  size_t i = 0;
+  while ((i < len) && (rep < TEST_BUF_RANDOM_REPS)) {
+    size_t chunk = (rand() % 200) + 1;
+    if (chunk > (len - i)) {
+      chunk = len - i;
+    }
+    size_t used = nmea_parse_buf(&bn, &s[i], chunk);
+    size_t j = 0;
+    while (j < used) {
+      nmea_parse(&cn, s[i + j]);
+      ++j;
+    }
+    nmea_decode(&bn, ~(nmea_field_bitmap_t)0);
+    nmea_decode(&cn, ~(nmea_field_bitmap_t)0);
+    if ((bn.state.received != cn.state.received) ||
+        (memcmp(&bn.data, &cn.data, sizeof(bn.data)) != 0)) {
+      printf("ERR: buffer parse differs from char parse at %lu\n",
+             (unsigned long int)(i + used));
+      return -1;
+    }
+    i += used;
+    ++rep;
+  }
+
+  return 0;
+}
+
+/* test that only the requested fields, and the direction fields they depend
+ * on, are decoded */
+int test_lazy(void) {
+  char s[] = "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+             "47.5,M,,*74";
+
+  struct nmea n;
+  nmea_init(&n);
+
+  size_t len = sizeof(s) - 1;
+  size_t used = nmea_parse_buf(&n, s, len);
+  if (used != len) {
+    printf("ERR: lazy GGA stopped at %lu\n", (unsigned long int)used);
+    return -1;
+  }
+  if (nmea_fields_ready(&n, NMEA_FIELD_LATITUDE_MASK |
+                                NMEA_FIELD_LONGITUDE_MASK) != 1) {
+    printf("ERR: lazy GGA did not set the required field flags %lx\n",
+           n.state.received);
+    return -1;
+  }
+
+  nmea_decode(&n, NMEA_FIELD_LATITUDE_MASK | NMEA_FIELD_LONGITUDE_MASK);
+
+  double lat = nmea_fxp_to_double(n.data.latitude, NMEA_FIELD_LATITUDE);
+  double lon = nmea_fxp_to_double(n.data.longitude, NMEA_FIELD_LONGITUDE);
+  if ((double_comp(lat, 51.072405, 0.000001) != 0) ||
+      (double_comp(lon, -1.788302, 0.000001) != 0)) {
+    printf("ERR: lazy GGA position incorrect, received: %f, %f\n", lat, lon);
+    return -1;
+  }
+
+#if defined(NMEA_LAZY_DECODE)
+  if (n.data.altitude != 0) {
+    printf("ERR: lazy GGA decoded altitude\n");
+    return -1;
+  }
+
+  /* the altitude is dropped when the next recorded sentence starts */
+  char v[] = "$GPVTG,213.73,T,,M,34.075,N,63.106,K,A*3E";
+  nmea_parse_buf(&n, v, sizeof(v) - 1);
+  if (nmea_fields_ready(&n, NMEA_FIELD_ALTITUDE_MASK) != 0) {
+    printf("ERR: undecoded GGA altitude still flagged as received\n");
+    return -1;
+  }
+  nmea_decode(&n, NMEA_FIELD_ALTITUDE_MASK | NMEA_FIELD_SPEED_MASK);
+  if ((n.data.altitude != 0) || (n.data.speed == 0)) {
+    printf("ERR: lazy VTG decoded the wrong fields\n");
+    return -1;
+  }
+#endif
+
+  return 0;
+}
+
+/* test that only subscribed sentences and fields are parsed, along with the
+ * fields that they depend on */
+int test_subscribed(void) {
+  char s[] = "$GPTXT,01,01,02,ANTSTATUS=OK*3B\r\n"
+             "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+             "47.5,M,,*74\r\n"
+             "$GPRMC,175456.00,A,5104.34432,N,00147.29814,W,34.075,213.73,"
+             "080321,,,A*47\r\n";
+  size_t len = sizeof(s) - 1;
+
+  struct nmea n;
+  nmea_init_subscribed(&n, NMEA_SENTENCE_RMC_MASK,
+                       NMEA_FIELD_TIME_MASK | NMEA_FIELD_LATITUDE_MASK);
+
+  /* the TXT and GGA sentences are skipped */
+  size_t used = nmea_parse_buf(&n, s, len);
+  nmea_decode(&n, ~(nmea_field_bitmap_t)0);
+  if (used != (size_t)(strstr(s, "*47") + 3 - s)) {
+    printf("ERR: subscribed parse stopped at %lu\n", (unsigned long int)used);
+    return -1;
+  }
+  if (n.data.altitude != 0) {
+    printf("ERR: unsubscribed GGA parsed\n");
+    return -1;
+  }
+  if (nmea_fields_ready(&n, NMEA_FIELD_TIME_MASK | NMEA_FIELD_LATITUDE_MASK) !=
+      1) {
+    printf("ERR: subscribed RMC did not set the required field flags %lx\n",
+           n.state.received);
+    return -1;
+  }
+  if ((n.state.received & ~NMEA_FIELD_LATITUDE_DIR_MASK) != 0) {
+    printf("ERR: subscribed RMC set extra field flags %lx\n",
+           n.state.received);
+    return -1;
+  }
+  if ((n.data.time % 86400) != 64496) {
+    printf("ERR: subscribed RMC time incorrect\n");
+    return -1;
+  }
+  double lat = nmea_fxp_to_double(n.data.latitude, NMEA_FIELD_LATITUDE);
+  if ((double_comp(lat, 51.072405, 0.000001) != 0) || (n.data.speed != 0) ||
+      (n.data.longitude != 0)) {
+    printf("ERR: subscribed RMC fields incorrect\n");
+    return -1;
+  }
+
+  /* the GSV sentence numbers and SNR, which moves on to the next satellite,
+   * are parsed for the PRNs */
+  nmea_init_subscribed(&n, NMEA_SENTENCE_GSV_MASK, NMEA_FIELD_PRN_MASK);
+  test_parse_string(
+      &n, "$GPGSV,2,1,08,05,02,020,,07,,,33,16,76,272,33,18,58,069,31*48"
+          "$GPGSV,2,2,08,20,,,24,23,28,121,20,26,,,31,27,46,274,32*7F");
+  if (nmea_fields_ready(&n, NMEA_FIELD_PRN_MASK) != 1) {
+    printf("ERR: subscribed GSV did not set the required field flags %lx\n",
+           n.state.received);
+    return -1;
+  }
+  if ((n.data.sats[0].prn != 5) || (n.data.sats[7].prn != 27) ||
+      (n.data.sats[7].azimuth != 0) || (n.data.satellites_in_view != 0)) {
+    printf("ERR: subscribed GSV satellites incorrect\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+/* test dates across leap days and centuries, and that a changed century is
+ * not hidden by the cached date */
+int test_date(void) {
+  static const struct {
+    const char *date;
+    unsigned long int century;
+    long long int time;
+  } dates[] = {{"010100", 2000, 946684800ll},  {"290224", 2000, 1709164800ll},
+               {"010324", 2000, 1709251200ll}, {"311299", 2000, 4102358400ll},
+               {"010300", 2100, 4107542400ll}, {"010170", 1900, 0},
+               {"080321", 2100, 4770835200ll}, {"080321", 2000, 1615161600ll}};
+
+  struct nmea n;
+  nmea_init(&n);
+
+  unsigned char i = 0;
+  while (i < (sizeof(dates) / sizeof(dates[0]))) {
+    char body[80];
+    snprintf(body, sizeof(body), "GPRMC,000000.00,A,,,,,,,%s,,,A",
+             dates[i].date);
+    nmea_set_century(&n, dates[i].century);
+    test_parse_body(&n, body);
+    if (nmea_fields_ready(&n, NMEA_FIELD_DATE_MASK) != 1) {
+      printf("ERR: date %u did not set the required field flags %lx\n", i,
+             n.state.received);
+      return -1;
+    }
+    if (n.data.time != dates[i].time) {
+      printf("ERR: date %u incorrect, received: %lld, expected: %lld\n", i,
+             n.data.time, dates[i].time);
+      return -1;
+    }
+    ++i;
+  }
+
+  /* the cached date with a new time */
+  test_parse_body(&n, "GPRMC,175456.00,A,,,,,,,080321,,,A");
+  if (n.data.time != 0x604664f0) {
+    printf("ERR: cached date incorrect, received: 0x%llx\n", n.data.time);
+    return -1;
+  }
+
+  return 0;
+}
+
+struct test_callback_calls {
+  unsigned int count;
+  enum nmea_sentences sentence;
+  nmea_field_bitmap_t fields;
+  long long int latitude;
+};
+
+static void test_callback(const struct nmea_data *const data,
+                          const enum nmea_sentences sentence,
+                          const nmea_field_bitmap_t fields, void *const ctx) {
+  struct test_callback_calls *const calls = ctx;
+  ++calls->count;
+  calls->sentence = sentence;
+  calls->fields = fields;
+  calls->latitude = data->latitude;
+}
+
+/* test that callbacks are called for the sentences and fields they want, and
+ * don't consume the fields */
+int test_callbacks(void) {
+  struct test_callback_calls position = {0, NMEA_SENTENCE_GGA, 0, 0};
+  struct test_callback_calls all = {0, NMEA_SENTENCE_GGA, 0, 0};
+  const struct nmea_callback callbacks[] = {
+      {&test_callback, NMEA_SENTENCE_GGA_MASK | NMEA_SENTENCE_RMC_MASK,
+       NMEA_FIELD_LATITUDE_MASK, &position},
+      {&test_callback, ~(nmea_sentence_bitmap_t)0, ~(nmea_field_bitmap_t)0,
+       &all}};
+
+  struct nmea n;
+  nmea_init(&n);
+  nmea_set_callbacks(&n, callbacks, sizeof(callbacks) / sizeof(callbacks[0]));
+
+  char s[] = "$GPVTG,213.73,T,,M,34.075,N,63.106,K,A*3E\r\n"
+             "$GPGSV,2,1,08,05,02,020,,07,,,33,16,76,272,33,18,58,069,31*48"
+             "\r\n";
+  size_t len = sizeof(s) - 1;
+  size_t used = 0;
+  while (used < len) {
+    used += nmea_parse_buf(&n, &s[used], len - used);
+  }
+  if ((position.count != 0) || (all.count != 1) ||
+      (all.sentence != NMEA_SENTENCE_VTG) ||
+      ((all.fields & NMEA_FIELD_SPEED_MASK) == 0)) {
+    printf("ERR: VTG callbacks incorrect\n");
+    return -1;
+  }
+
+  /* a GSV set calls back once it is complete */
+  test_parse_string(
+      &n, "$GPGSV,2,2,08,20,,,24,23,28,121,20,26,,,31,27,46,274,32*7F");
+  if ((all.count != 2) || (all.sentence != NMEA_SENTENCE_GSV)) {
+    printf("ERR: GSV callbacks incorrect\n");
+    return -1;
+  }
+
+  /* a failed checksum does not call back */
+  test_parse_string(&n, "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,"
+                        "2.88,61.8,M,47.5,M,,*75");
+  if (all.count != 2) {
+    printf("ERR: callback called for a failed checksum\n");
+    return -1;
+  }
+
+  char gga[] = "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,"
+               "47.5,M,,*74";
+  nmea_parse_buf(&n, gga, sizeof(gga) - 1);
+  double lat = nmea_fxp_to_double(position.latitude, NMEA_FIELD_LATITUDE);
+  if ((position.count != 1) || (all.count != 3) ||
+      (position.sentence != NMEA_SENTENCE_GGA) ||
+      (double_comp(lat, 51.072405, 0.000001) != 0)) {
+    printf("ERR: GGA callbacks incorrect\n");
+    return -1;
+  }
+  if (nmea_fields_ready(&n, NMEA_FIELD_SPEED_MASK | NMEA_FIELD_PRN_MASK |
+                                NMEA_FIELD_LATITUDE_MASK) != 1) {
+    printf("ERR: callbacks consumed the field flags %lx\n", n.state.received);
+    return -1;
+  }
+
+  nmea_set_callbacks(&n, 0, 0);
+  test_parse_string(&n, gga);
+  if (all.count != 3) {
+    printf("ERR: removed callback called\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+/* test that the statistics count each kind of event, the same for both parse
+ * functions */
+int test_stats(void) {
+#if defined(NMEA_STATS)
+  static const char *const bodies[] = {
+      "GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,M,,",
+      "GPRMC,175456.00,A,5104.34432,N,00147.29814,W,34.075,213.73,080321,,,A",
+      "GPTXT,01,01,02,ANTSTATUS=OK",
+      "GPGSV,2,1,08,05,02,020,,07,,,33,16,76,272,33,18,58,069,31",
+      "GLGSV,2,1,08,05,02,020,,07,,,33,16,76,272,33,18,58,069,31",
+      "GLGSV,2,2,08,20,,,24,23,28,121,20,26,,,31,27,46,274,32",
+      "GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,"
+      "99999999999999999999999.8,M,47.5,M,,"};
+  char s[1024];
+  size_t len = 0;
+  size_t i = 0;
+  while (i < (sizeof(bodies) / sizeof(bodies[0]))) {
+    unsigned char checksum = nmea_checksum(bodies[i], strlen(bodies[i]));
+    if (i == 1) {
+      /* corrupt the RMC */
+      checksum ^= 1;
+    }
+    len += snprintf(&s[len], sizeof(s) - len, "$%s*%02X\r\n", bodies[i],
+                    checksum);
+    ++i;
+  }
+
+  struct nmea n;
+  nmea_init(&n);
+  test_parse_string(&n, s);
+  struct nmea_stats stats;
+  nmea_stats_get(&n, &stats);
+  if ((stats.sentences[NMEA_SENTENCE_GGA] != 2) ||
+      (stats.sentences[NMEA_SENTENCE_GSV] != 3) ||
+      (stats.sentences[NMEA_SENTENCE_RMC] != 0) ||
+      (stats.checksum_passes != 5) || (stats.checksum_failures != 1) ||
+      (stats.unknown_sentences != 1) || (stats.saturations != 1) ||
+      (stats.gsv_sets_abandoned != 1) || (stats.bytes != len)) {
+    printf("ERR: stats incorrect, passes: %llu, failures: %llu, unknown: "
+           "%llu, saturations: %llu, abandoned: %llu, bytes: %llu\n",
+           stats.checksum_passes, stats.checksum_failures,
+           stats.unknown_sentences, stats.saturations,
+           stats.gsv_sets_abandoned, stats.bytes);
+    return -1;
+  }
+
+  struct nmea b;
+  nmea_init(&b);
+  i = 0;
+  while (i < len) {
+    i += nmea_parse_buf(&b, &s[i], len - i);
+    nmea_decode(&b, ~(nmea_field_bitmap_t)0);
+  }
+  struct nmea_stats buf_stats;
+  nmea_stats_get(&b, &buf_stats);
+  if (memcmp(&stats, &buf_stats, sizeof(stats)) != 0) {
+    printf("ERR: buffer parsing stats differ\n");
+    return -1;
+  }
+
+  char text[2048];
+  const int text_len =
+      nmea_stats_prometheus(&stats, "port=\"a\"", text, sizeof(text));
+  if ((text_len != (int)strlen(text)) ||
+      (strstr(text, "\nnmea_sentences_total{sentence=\"GGA\","
+                    "port=\"a\"} 2\n") == 0) ||
+      (strstr(text, "\nnmea_saturations_total{port=\"a\"} 1\n") == 0) ||
+      (strstr(text, "# TYPE nmea_bytes_total counter\n") == 0)) {
+    printf("ERR: prometheus text incorrect:\n%s\n", text);
+    return -1;
+  }
+  char small[16];
+  if (nmea_stats_prometheus(&stats, "port=\"a\"", small, sizeof(small)) !=
+      text_len) {
+    printf("ERR: truncated prometheus text length incorrect\n");
+    return -1;
+  }
+#endif
+
+  return 0;
+}
+
+/* test that the latency quantiles are within a bucket of the recorded values,
+ * and that parsing records a latency for each supported sentence */
+int test_latency(void) {
+#if defined(NMEA_LATENCY)
+  static struct nmea_latency_histogram h;
+  memset(&h, 0, sizeof(h));
+  if (nmea_latency_quantile(&h, 0.5) != 0) {
+    printf("ERR: empty latency quantile not 0\n");
+    return -1;
+  }
+  unsigned long long int ns = 1;
+  while (ns <= 100000) {
+    nmea_latency_record(&h, ns);
+    ++ns;
+  }
+  static const double qs[] = {0.5, 0.99, 0.999};
+  size_t i = 0;
+  while (i < (sizeof(qs) / sizeof(qs[0]))) {
+    const unsigned long long int expected =
+        (unsigned long long int)(qs[i] * 100000);
+    const unsigned long long int actual = nmea_latency_quantile(&h, qs[i]);
+    if ((actual < expected) || ((actual - expected) > (expected / 16))) {
+      printf("ERR: latency quantile %f, expected: %llu, actual: %llu\n", qs[i],
+             expected, actual);
+      return -1;
+    }
+    ++i;
+  }
+  if ((nmea_latency_quantile(&h, 1) != 100000) || (h.max != 100000)) {
+    printf("ERR: latency max incorrect\n");
+    return -1;
+  }
+
+  memset(&h, 0, sizeof(h));
+  nmea_latency_record(&h, 3);
+  nmea_latency_record(&h, 7);
+  if ((nmea_latency_quantile(&h, 0.5) != 3) ||
+      (nmea_latency_quantile(&h, 1) != 7)) {
+    printf("ERR: small latencies not exact\n");
+    return -1;
+  }
+
+  struct nmea n;
+  nmea_init(&n);
+  test_parse_string(
+      &n, "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,"
+          "M,,*74\r\n"
+          "$GPTXT,01,01,02,ANTSTATUS=OK*3B\r\n"
+          "$GPGGA,175456.00,5104.34432,N,00147.29814,W,1,03,2.88,61.8,M,47.5,"
+          "M,,*74\r\n");
+  const struct nmea_latency_histogram *const gga =
+      &n.latency.sentences[NMEA_SENTENCE_GGA];
+  if ((gga->total != 2) || (gga->max == 0) ||
+      (n.latency.sentences[NMEA_SENTENCE_RMC].total != 0)) {
+    printf("ERR: parsed latency incorrect, total: %llu, max: %llu\n",
+           gga->total, gga->max);
+    return -1;
+  }
+#endif
+
+  return 0;
+}
+
 int main(int argc, char **argv) {
   (void)argc;
   (void)argv;
@@ -514,15 +1209,75 @@ int main(int argc, char **argv) {
     return rc;
   }
 
+  rc = test_talkers();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_consecutive();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_checksum();
+  if (rc != 0) {
+    return rc;
+  }
+
   rc = test_txt();
   if (rc != 0) {
     return rc;
   }
 
+  rc = test_parse_buf();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_parse_buf_random();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_header_length();
+  if (rc != 0) {
+    return rc;
+  }
+
   rc = test_random();
   if (rc != 0) {
     return rc;
   }
 
+  rc = test_lazy();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_subscribed();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_date();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_callbacks();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_stats();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = test_latency();
+  if (rc != 0) {
+    return rc;
+  }
+
   return 0;
 }